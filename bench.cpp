@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef BOIDS_BENCH_TBB
+#include <tbb/global_control.h>
+#endif
+
+#include "simulation/config.hpp"
+#include "simulation/flock.hpp"
+#include "simulation/grid.hpp"
+#include "simulation/obstacles.hpp"
+#include "simulation/predator.hpp"
+#include "simulation/random.hpp"
+
+// Measures the stages of the simulation over every combination of the given
+// numbers of boids, predators, obstacles and threads, and prints median and
+// 95th percentile of the timings as CSV or JSON. Arguments:
+//   --boids=1000,10000   --predators=0,10   --obstacles=0,100
+//   --threads=0 (0 = all the available ones)   --repeats=20   --seed=1
+//   --format=csv|json
+// Each combination starts from the same seed, so runs are comparable
+namespace {
+struct Options {
+  std::vector<int> boids{1000, 10000, 100000};
+  std::vector<int> predators{0, 10};
+  std::vector<int> obstacles{0, 100};
+  std::vector<int> threads{0};
+  int repeats{20};
+  std::uint64_t seed{1};
+  std::string format{"csv"};
+};
+
+struct Result {
+  int boids;
+  int predators;
+  int obstacles;
+  int threads;
+  std::string stage;
+  double median;
+  double p95;
+};
+
+template <typename T>
+T parse(std::string const& key, std::string const& text) {
+  std::istringstream stream(text);
+  T value{};
+  stream >> value;
+  if (stream.fail() || !(stream >> std::ws).eof()) {
+    throw std::runtime_error("Invalid value for " + key + ": " + text + '\n');
+  }
+  return value;
+}
+
+std::vector<int> parse_list(std::string const& key, std::string const& text) {
+  std::vector<int> values;
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    int value = parse<int>(key, item);
+    if (value < 0) throw std::runtime_error("Invalid value for " + key + '\n');
+    values.push_back(value);
+  }
+  if (values.empty()) throw std::runtime_error("Empty list for " + key + '\n');
+  return values;
+}
+
+Options from_args(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto equal = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equal == std::string::npos) {
+      throw std::runtime_error("Invalid argument " + arg + '\n');
+    }
+    std::string key = arg.substr(2, equal - 2);
+    std::string value = arg.substr(equal + 1);
+    if (key == "boids") {
+      options.boids = parse_list(key, value);
+    } else if (key == "predators") {
+      options.predators = parse_list(key, value);
+    } else if (key == "obstacles") {
+      options.obstacles = parse_list(key, value);
+    } else if (key == "threads") {
+      options.threads = parse_list(key, value);
+    } else if (key == "repeats") {
+      options.repeats = parse<int>(key, value);
+    } else if (key == "seed") {
+      options.seed = parse<std::uint64_t>(key, value);
+    } else if (key == "format") {
+      options.format = value;
+    } else {
+      throw std::runtime_error("Unknown parameter " + key + '\n');
+    }
+  }
+  if (options.repeats <= 0) throw std::runtime_error("Invalid repeats\n");
+  if (options.format != "csv" && options.format != "json") {
+    throw std::runtime_error("Invalid format " + options.format + '\n');
+  }
+  return options;
+}
+
+// Times f() once per repeat, in milliseconds. prepare() runs before each
+// repeat, out of the measure
+template <typename P, typename F>
+std::vector<double> measure(int repeats, P&& prepare, F&& f) {
+  std::vector<double> times;
+  for (int r = 0; r < repeats; ++r) {
+    prepare();
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    times.push_back(elapsed.count());
+  }
+  return times;
+}
+
+// Nearest-rank percentile, with q in (0, 1]
+double percentile(std::vector<double> times, double q) {
+  std::sort(times.begin(), times.end());
+  auto rank = static_cast<std::size_t>(
+      std::ceil(q * static_cast<double>(times.size())));
+  return times[std::max(rank, std::size_t{1}) - 1];
+}
+
+// The space grows with the number of boids and obstacles, so that the
+// density is the one of the default window (1000 boids, 50 obstacles)
+mt::Vec2 scaled_space(cf::Config const& config, int boids, int obstacles) {
+  double scale = std::max({1., boids / 1000., obstacles / 50.});
+  return {config.width * std::sqrt(scale), config.height * std::sqrt(scale)};
+}
+
+// Preys of each predator: the boids it sees in its range, found with a cell
+// list, as in Flock::update_global_state
+std::vector<std::pair<bd::Boid, int>> find_preys(
+    fk::Flock const& flock, std::vector<pr::Predator> const& preds,
+    mt::Vec2 const& space) {
+  std::vector<std::pair<bd::Boid, int>> preys;
+  if (preds.empty()) return preys;
+  double range = 0.;
+  for (auto const& pred : preds) range = std::max(range, pred.get_range());
+  gr::Grid grid;
+  grid.build(range, space, flock.get_state().x, flock.get_state().y);
+  auto const& boids = flock.get_flock();
+  auto const& items = grid.get_items();
+  for (std::size_t p = 0; p < preds.size(); ++p) {
+    auto const& pos = preds[p].get_pos();
+    grid.for_each_near_range(
+        pos[0], pos[1], [&](std::size_t first, std::size_t last) {
+          for (auto k = first; k < last; ++k) {
+            auto const& boid = boids[items[k]];
+            if (bd::is_visible(boid, preds[p]) &&
+                bd::boid_dist(preds[p], boid) < preds[p].get_range()) {
+              preys.push_back({boid, static_cast<int>(p)});
+            }
+          }
+        });
+  }
+  return preys;
+}
+
+void run(Options const& options, int boids, int predators, int obstacles,
+         std::vector<Result>& results) {
+  cf::Config config;
+  rn::set_seed(options.seed);
+  mt::Vec2 space = scaled_space(config, boids, obstacles);
+  std::vector<ob::Obstacle> obs =
+      ob::generate_obstacles(obstacles, config.obstacles_max_size, space);
+  fk::Parameters params(config.d, config.d_s, config.s, config.a, config.c);
+  fk::Flock flock{params, boids, config.view_angle, space, obs};
+  std::vector<pr::Predator> preds = pr::random_predators(
+      obs, predators, space, config.pred_view_angle, config.pred_ds,
+      config.pred_s, config.pred_range, config.pred_hunger);
+
+  int threads = 0;
+  auto add = [&](std::string const& stage, std::vector<double> const& times) {
+    results.push_back({boids, predators, obstacles, threads, stage,
+                       percentile(times, 0.5), percentile(times, 0.95)});
+  };
+  auto nothing = [] {};
+
+  for (int n_threads : options.threads) {
+    threads = n_threads;
+#ifdef BOIDS_BENCH_TBB
+    std::unique_ptr<tbb::global_control> limit;
+    if (n_threads > 0) {
+      limit = std::make_unique<tbb::global_control>(
+          tbb::global_control::max_allowed_parallelism,
+          static_cast<std::size_t>(n_threads));
+    }
+#else
+    if (n_threads > 0) {
+      throw std::runtime_error("Thread counts require TBB\n");
+    }
+#endif
+
+    // Every thread count starts from the same flock and predators
+    fk::Flock stepped = flock;
+    std::vector<pr::Predator> stepped_preds = preds;
+    stepped.update_global_state(config.delta_t, config.periodic,
+                                stepped_preds, obs);
+    add("update_global_state",
+        measure(options.repeats, nothing, [&] {
+          stepped.update_global_state(config.delta_t, config.periodic,
+                                      stepped_preds, obs);
+        }));
+
+    // Sort of the flock after the boids moved for a step, as in the update
+    fk::Flock moved{params, 0, config.view_angle, space};
+    for (auto boid : stepped.get_flock()) {
+      auto const& pos = boid.get_pos();
+      auto const& vel = boid.get_vel();
+      boid.set_state(pos[0] + vel[0] * config.delta_t,
+                     pos[1] + vel[1] * config.delta_t, vel[0], vel[1]);
+      moved.push_back(boid);
+    }
+    // The flock was built empty, so its centre of mass is computed again
+    moved.update_com();
+    fk::Flock sorted = moved;
+    add("sort", measure(
+                    options.repeats, [&] { sorted = moved; },
+                    [&] { sorted.sort(); }));
+
+    add("update_stats",
+        measure(options.repeats, nothing, [&] { stepped.update_stats(); }));
+
+    ob::ObstacleGrid obs_grid;
+    obs_grid.build(obs, space);
+    auto const& all_boids = stepped.get_flock();
+    std::vector<mt::Vec2> corrections(all_boids.size());
+    add("avoid_obs", measure(options.repeats, nothing, [&] {
+          std::transform(
+              std::execution::par, all_boids.begin(), all_boids.end(),
+              corrections.begin(),
+              [&](bd::Boid const& boid) { return boid.avoid_obs(obs_grid); });
+        }));
+
+    if (!preds.empty()) {
+      auto const preys = find_preys(stepped, stepped_preds, space);
+      std::vector<pr::Predator> copy_preds;
+      add("update_predators_state",
+          measure(
+              options.repeats, [&] { copy_preds = stepped_preds; },
+              [&] {
+                pr::update_predators_state(copy_preds, config.delta_t,
+                                           config.periodic, preys, obs);
+              }));
+    }
+  }
+}
+
+void print(Options const& options, std::vector<Result> const& results) {
+  std::cout << std::fixed << std::setprecision(4);
+  if (options.format == "csv") {
+    std::cout << "boids,predators,obstacles,threads,stage,repeats,median_ms,"
+                 "p95_ms\n";
+    for (auto const& r : results) {
+      std::cout << r.boids << ',' << r.predators << ',' << r.obstacles << ','
+                << r.threads << ',' << r.stage << ',' << options.repeats << ','
+                << r.median << ',' << r.p95 << '\n';
+    }
+  } else {
+    std::cout << "{\n  \"seed\": " << options.seed
+              << ",\n  \"repeats\": " << options.repeats
+              << ",\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      auto const& r = results[i];
+      std::cout << (i == 0 ? "\n" : ",\n") << "    {\"boids\": " << r.boids
+                << ", \"predators\": " << r.predators
+                << ", \"obstacles\": " << r.obstacles
+                << ", \"threads\": " << r.threads << ", \"stage\": \""
+                << r.stage << "\", \"median_ms\": " << r.median
+                << ", \"p95_ms\": " << r.p95 << '}';
+    }
+    std::cout << "\n  ]\n}\n";
+  }
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // try-catch structure is used to handle exceptions
+  try {
+    Options options = from_args(argc, argv);
+    std::vector<Result> results;
+    for (int boids : options.boids) {
+      if (boids == 0) throw std::runtime_error("Invalid value for boids\n");
+      for (int predators : options.predators) {
+        for (int obstacles : options.obstacles) {
+          run(options, boids, predators, obstacles, results);
+        }
+      }
+    }
+    print(options, results);
+    return EXIT_SUCCESS;
+  } catch (std::exception& e) {
+    // handle standard exceptions, printing them to standard error output
+    std::cerr << e.what();
+  } catch (...) {
+    std::cerr << "Unknown exception";
+  }
+  return EXIT_FAILURE;
+}
@@ -1,6 +1,7 @@
 #include "animation.hpp"
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <execution>
@@ -104,21 +105,20 @@ void gf::Animate::animate() { setState(a_state + 1); }
 
 std::vector<gf::Animate> gf::create_animates(
     fk::Flock& flock, std::vector<sf::Texture> const& textures, float margin) {
-  std::vector<gf::Animate> animates;
-  std::transform(
-      flock.begin(), flock.end(), std::back_inserter(animates),
-      [&margin, &textures](bd::Boid& b) -> gf::Animate {
-        gf::Animate sp_boid(
-            0.5f * margin / static_cast<float>(textures[0].getSize().x),
-            textures);
-        (mt::vec_norm<double>(b.get_vel()) > 200.) ? sp_boid.setState(1)
-                                                   : sp_boid.setState(0);
-        sp_boid.setPosition(static_cast<float>(b.get_pos()[0]) + margin,
-                            static_cast<float>(b.get_pos()[1]) + margin);
-        sp_boid.setRotation(180.f - static_cast<float>(b.get_angle()));
-        return sp_boid;
-      });
-  assert(animates.size() == static_cast<unsigned int>(flock.size()));
+  // Animates are indexed by the slots of the boids
+  std::vector<gf::Animate> animates(
+      flock.get_slots(),
+      gf::Animate(0.5f * margin / static_cast<float>(textures[0].getSize().x),
+                  textures));
+  auto const& state = flock.get_state();
+  for (std::size_t i = 0; i < state.size(); ++i) {
+    auto& sp_boid = animates[state.slot[i]];
+    (std::hypot(state.vx[i], state.vy[i]) > 200.) ? sp_boid.setState(1)
+                                                  : sp_boid.setState(0);
+    sp_boid.setPosition(static_cast<float>(state.x[i]) + margin,
+                        static_cast<float>(state.y[i]) + margin);
+    sp_boid.setRotation(180.f - static_cast<float>(state.get_angle(i)));
+  }
   return animates;
 }
 
@@ -131,8 +131,8 @@ std::vector<gf::Animate> gf::create_animates(
       [&margin, &textures](pr::Predator const& pred) -> gf::Animate {
         gf::Animate sp_pred(
             margin / static_cast<float>(textures[0].getSize().x), textures);
-        (mt::vec_norm<double>(pred.get_vel()) > 200.) ? sp_pred.setState(1)
-                                                      : sp_pred.setState(0);
+        (mt::vec_norm(pred.get_vel()) > 200.) ? sp_pred.setState(1)
+                                              : sp_pred.setState(0);
         sp_pred.setPosition(static_cast<float>(pred.get_pos()[0]) + margin,
                             static_cast<float>(pred.get_pos()[1]) + margin);
         sp_pred.setRotation(180.f - static_cast<float>(pred.get_angle()));
@@ -144,23 +144,21 @@ std::vector<gf::Animate> gf::create_animates(
 
 // constructor, draw and methods of Tracker
 
-gf::Tracker::Tracker(std::valarray<float> const& range,
-                     std::valarray<float> const& pos, float scale, float margin)
+gf::Tracker::Tracker(sf::Vector2f const& range,
+                     sf::Vector2f const& pos, float scale, float margin)
     : t_outer(),
       t_inner(),
       t_bird(Bird(10.f)),
       t_path(sf::LineStrip, 0),
       t_range(range),
       t_pos(pos) {
-  assert(t_range.size() == 2);
-  assert(t_pos.size() == 2);
   assert(scale > 0.f);
-  t_inner.setSize(sf::Vector2f(t_range[0] * scale, t_range[1] * scale));
-  t_outer.setSize(sf::Vector2f(t_range[0] * scale + 2 * margin,
-                               t_range[1] * scale + 2 * margin));
+  t_inner.setSize(sf::Vector2f(t_range.x * scale, t_range.y * scale));
+  t_outer.setSize(sf::Vector2f(t_range.x * scale + 2 * margin,
+                               t_range.y * scale + 2 * margin));
   t_inner.move(margin, margin);
   t_bird.setSize(margin);
-  t_bird.setPosition(t_pos[0] * scale + margin, t_pos[1] * scale + margin);
+  t_bird.setPosition(t_pos.x * scale + margin, t_pos.y * scale + margin);
 }
 
 void gf::Tracker::draw(sf::RenderTarget& target,
@@ -207,14 +205,13 @@ void gf::Tracker::setOutlineThickness(float outer, float inner, float circle) {
   t_bird.setOutlineThickness(circle);
 }
 
-void gf::Tracker::update_pos(std::valarray<float> const& position) {
-  assert(position.size() == 2);
+void gf::Tracker::update_pos(sf::Vector2f const& position) {
   t_pos = position;
   t_bird.setPosition(
-      t_pos[0] * t_inner.getSize().x / t_range[0] + t_inner.getPosition().x,
-      t_pos[1] * t_inner.getSize().y / t_range[1] + t_inner.getPosition().y);
-  if (t_pos[0] > 0.f && t_pos[1] > 0.f && t_pos[0] < t_range[0] &&
-      t_pos[1] < t_range[1]) {
+      t_pos.x * t_inner.getSize().x / t_range.x + t_inner.getPosition().x,
+      t_pos.y * t_inner.getSize().y / t_range.y + t_inner.getPosition().y);
+  if (t_pos.x > 0.f && t_pos.y > 0.f && t_pos.x < t_range.x &&
+      t_pos.y < t_range.y) {
     if (t_path.getVertexCount() < 30) {
       sf::Vertex vertex(
           t_bird.getPosition(),
@@ -241,14 +238,13 @@ sf::RectangleShape const& gf::Tracker::getOuter() const { return t_outer; }
 
 gf::StatusBar::StatusBar(std::string const& title, sf::Font const& font,
                          float width, float height,
-                         std::valarray<float> const& range)
+                         sf::Vector2f const& range)
     : s_text(title, font) {
-  assert(range.size() == 2 && range[0] < range[1] && width > 0.f &&
-         height > 0.f);
+  assert(range.x < range.y && width > 0.f && height > 0.f);
   s_outer = sf::RectangleShape(sf::Vector2f{width, height});
   s_bar = sf::RectangleShape(sf::Vector2f{width, height});
   s_range = range;
-  s_value = range[0];
+  s_value = range.x;
   s_text.setCharacterSize(static_cast<unsigned int>(height));
   s_outer.setFillColor(sf::Color::Transparent);
   s_outer.setOutlineColor(sf::Color::Black);
@@ -260,11 +256,11 @@ gf::StatusBar::StatusBar(std::string const& title, sf::Font const& font,
                static_cast<float>(s_text.getCharacterSize()) / 2.f);
   s_bar.setPosition(s_outer.getPosition());
   std::ostringstream s_min_max;
-  s_min_max << std::setprecision(1) << std::fixed << s_range[0];
+  s_min_max << std::setprecision(1) << std::fixed << s_range.x;
   s_min = sf::Text(s_min_max.str(), font, static_cast<unsigned int>(height));
   s_min.setFillColor(sf::Color::Black);
   s_min_max.str("");
-  s_min_max << std::setprecision(1) << std::fixed << s_range[1];
+  s_min_max << std::setprecision(1) << std::fixed << s_range.y;
   s_max = sf::Text(s_min_max.str(), font, static_cast<unsigned int>(height));
   s_max.setFillColor(sf::Color::Black);
   s_min_max.str("");
@@ -307,22 +303,22 @@ void gf::StatusBar::setColors(sf::Color const& text_color,
 void gf::StatusBar::setOutlineThickness(float thickness) {
   s_outer.setOutlineThickness(thickness);
 }
-void gf::StatusBar::setRange(std::valarray<float> const& new_range) {
-  assert(new_range.size() == 2 && new_range[0] < new_range[1]);
+void gf::StatusBar::setRange(sf::Vector2f const& new_range) {
+  assert(new_range.x < new_range.y);
   s_range = new_range;
   std::ostringstream s_min_max;
-  s_min_max << std::setprecision(1) << std::fixed << s_range[0];
+  s_min_max << std::setprecision(1) << std::fixed << s_range.x;
   s_min.setString(s_min_max.str());
   s_min_max.str("");
-  s_min_max << std::setprecision(1) << std::fixed << s_range[1];
+  s_min_max << std::setprecision(1) << std::fixed << s_range.y;
   s_max.setString(s_min_max.str());
   s_min_max.str("");
 }
 
 void gf::StatusBar::update_value(float new_value) {
-  assert(new_value >= s_range[0] && new_value <= s_range[1]);
+  assert(new_value >= s_range.x && new_value <= s_range.y);
   s_value = new_value;
-  s_bar.setScale(s_value / (s_range[1] - s_range[0]), 1.f);
+  s_bar.setScale(s_value / (s_range.y - s_range.x), 1.f);
 }
 void gf::StatusBar::set_text(std::string const& new_text) {
   s_text.setString(new_text);
@@ -334,4 +330,66 @@ void gf::StatusBar::set_text(std::string const& new_text) {
   s_bar.move(displacement);
   s_min.move(displacement);
   s_max.move(displacement);
-}
\ No newline at end of file
+}
+
+// constructor, draw and methods of Sparkline
+
+gf::Sparkline::Sparkline(sf::Vector2f const& size, std::size_t count,
+                         float ref_value)
+    : sp_frame(size),
+      sp_line(sf::LineStrip, count),
+      sp_reference(sf::Lines, 2),
+      sp_values(count, 0.f),
+      sp_next(0),
+      sp_ref_value(ref_value) {
+  assert(count > 1 && ref_value > 0.f);
+  sp_frame.setFillColor(sf::Color::Transparent);
+  sp_frame.setOutlineThickness(2);
+  update_line();
+}
+
+void gf::Sparkline::draw(sf::RenderTarget& target,
+                         sf::RenderStates states) const {
+  target.draw(sp_frame, states);
+  target.draw(sp_reference, states);
+  target.draw(sp_line, states);
+}
+
+void gf::Sparkline::setPosition(sf::Vector2f const& position) {
+  sp_frame.setPosition(position);
+  update_line();
+}
+
+void gf::Sparkline::setColors(sf::Color const& line, sf::Color const& frame,
+                              sf::Color const& reference) {
+  sp_frame.setOutlineColor(frame);
+  for (std::size_t idx = 0; idx < sp_line.getVertexCount(); ++idx) {
+    sp_line[idx].color = line;
+  }
+  sp_reference[0].color = reference;
+  sp_reference[1].color = reference;
+}
+
+// The oldest value is overwritten
+void gf::Sparkline::push(float value) {
+  assert(value >= 0.f);
+  sp_values[sp_next] = value;
+  sp_next = (sp_next + 1) % sp_values.size();
+  update_line();
+}
+
+void gf::Sparkline::update_line() {
+  float top = std::max(
+      sp_ref_value, *std::max_element(sp_values.begin(), sp_values.end()));
+  sf::Vector2f origin = sp_frame.getPosition();
+  sf::Vector2f size = sp_frame.getSize();
+  float step = size.x / static_cast<float>(sp_values.size() - 1);
+  for (std::size_t idx = 0; idx < sp_values.size(); ++idx) {
+    float value = sp_values[(sp_next + idx) % sp_values.size()];
+    sp_line[idx].position = {origin.x + step * static_cast<float>(idx),
+                             origin.y + size.y * (1.f - value / top)};
+  }
+  float ref_y = origin.y + size.y * (1.f - sp_ref_value / top);
+  sp_reference[0].position = {origin.x, ref_y};
+  sp_reference[1].position = {origin.x + size.x, ref_y};
+}
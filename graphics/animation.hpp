@@ -2,7 +2,6 @@
 #define ANIMATION_HPP
 
 #include <SFML/Graphics.hpp>
-#include <valarray>
 #include <vector>
 
 #include "bird.hpp"
@@ -45,20 +44,19 @@ class Tracker : public sf::Drawable, public sf::Transformable {
   sf::RectangleShape t_inner;
   Bird t_bird;
   sf::VertexArray t_path;
-  std::valarray<float> t_range;
-  std::valarray<float> t_pos;
+  sf::Vector2f t_range;
+  sf::Vector2f t_pos;
 
  protected:
   virtual void draw(sf::RenderTarget&, sf::RenderStates) const;
 
  public:
-  Tracker(std::valarray<float> const&, std::valarray<float> const&, float,
-          float);
+  Tracker(sf::Vector2f const&, sf::Vector2f const&, float, float);
   void setPosition(sf::Vector2f const&);
   void setFillColors(sf::Color const&, sf::Color const&, sf::Color const&);
   void setOutlineColors(sf::Color const&, sf::Color const&, sf::Color const&);
   void setOutlineThickness(float, float, float);
-  void update_pos(std::valarray<float> const&);
+  void update_pos(sf::Vector2f const&);
   void update_angle(float);
   sf::RectangleShape const& getOuter() const;
 };
@@ -67,7 +65,7 @@ class StatusBar : public sf::Drawable, public sf::Transformable {
   sf::Text s_text;
   sf::RectangleShape s_outer;
   sf::RectangleShape s_bar;
-  std::valarray<float> s_range;
+  sf::Vector2f s_range;
   float s_value;
   sf::Text s_min;
   sf::Text s_max;
@@ -77,15 +75,39 @@ class StatusBar : public sf::Drawable, public sf::Transformable {
 
  public:
   StatusBar(std::string const&, sf::Font const&, float, float,
-            std::valarray<float> const&);
+            sf::Vector2f const&);
   void setPosition(sf::Vector2f const&);
   void setColors(sf::Color const&, sf::Color const&);
   void setOutlineThickness(float);
-  void setRange(std::valarray<float> const&);
+  void setRange(sf::Vector2f const&);
   void update_value(float);
   void set_text(std::string const&);
 };
 
+// Line chart of the last values pushed (e.g. frame times), scaled to the
+// largest of them and to a reference value, drawn as a horizontal line
+class Sparkline : public sf::Drawable, public sf::Transformable {
+  sf::RectangleShape sp_frame;
+  sf::VertexArray sp_line;
+  sf::VertexArray sp_reference;
+  std::vector<float> sp_values;
+  std::size_t sp_next;
+  float sp_ref_value;
+
+  // Places the vertices, from the oldest value on the left
+  void update_line();
+
+ protected:
+  virtual void draw(sf::RenderTarget&, sf::RenderStates) const;
+
+ public:
+  // Takes: size, number of values shown, reference value
+  Sparkline(sf::Vector2f const&, std::size_t, float);
+  void setPosition(sf::Vector2f const&);
+  void setColors(sf::Color const&, sf::Color const&, sf::Color const&);
+  void push(float);
+};
+
 }  // namespace gf
 
 #endif
\ No newline at end of file
@@ -89,16 +89,10 @@ void gf::Bird::move(sf::Vector2f const& offset) { bird_shape.move(offset); }
 
 std::vector<gf::Bird> gf::create_birds(fk::Flock& flock, sf::Color const& color,
                                        float margin) {
-  std::vector<gf::Bird> birds;
-  std::transform(flock.begin(), flock.end(), std::back_inserter(birds),
-                 [&margin, &color](bd::Boid& b) -> gf::Bird {
-                   gf::Bird tr_boid(margin / 2.f, color);
-                   tr_boid.setPosition(
-                       static_cast<float>(b.get_pos()[0]) + margin,
-                       static_cast<float>(b.get_pos()[1]) + margin);
-                   tr_boid.setRotation(-static_cast<float>(b.get_angle()));
-                   return tr_boid;
-                 });
+  // Birds are indexed by the slots of the boids
+  std::vector<gf::Bird> birds(flock.get_slots(),
+                              gf::Bird(margin / 2.f, color));
+  update_birds(birds, flock, margin);
   return birds;
 }
 
@@ -119,31 +113,18 @@ std::vector<gf::Bird> gf::create_birds(std::vector<pr::Predator> const& preds,
 
 void gf::update_birds(std::vector<gf::Bird>& birds, fk::Flock& flock,
                       float margin) {
-  int diff = flock.size() - static_cast<int>(birds.size());
-  if (diff > 0) {
-    auto color = birds[0].getFillColor();
-    for (int i = 0; i < diff; ++i) {
-      gf::Bird tr_bird(margin / 2.f, color);
-      birds.push_back(tr_bird);
-    }
-  } else if (diff < 0) {
-    auto sort_birds = [](gf::Bird const& b1, gf::Bird const& b2) -> bool {
-      if (b1.getPosition().x == b2.getPosition().x)
-        return b1.getPosition().y < b2.getPosition().y;
-      else
-        return b1.getPosition().x < b2.getPosition().x;
-    };
-    std::sort(birds.begin(), birds.end(), sort_birds);
-    birds.erase(birds.begin(), birds.begin() - diff);
+  // New slots get new birds, the birds of free slots are just not drawn
+  if (birds.size() < flock.get_slots()) {
+    auto color = birds.empty() ? sf::Color::White : birds[0].getFillColor();
+    birds.resize(flock.get_slots(), gf::Bird(margin / 2.f, color));
+  }
+  auto const& state = flock.get_state();
+  for (std::size_t i = 0; i < state.size(); ++i) {
+    auto& bird = birds[state.slot[i]];
+    bird.setPosition(static_cast<float>(state.x[i]) + margin,
+                     static_cast<float>(state.y[i]) + margin);
+    bird.setRotation(-static_cast<float>(state.get_angle(i)));
   }
-  std::transform(flock.begin(), flock.end(), birds.begin(), birds.begin(),
-                 [&margin](bd::Boid& b, gf::Bird& tr_boid) -> gf::Bird {
-                   tr_boid.setPosition(
-                       static_cast<float>(b.get_pos()[0]) + margin,
-                       static_cast<float>(b.get_pos()[1]) + margin);
-                   tr_boid.setRotation(-static_cast<float>(b.get_angle()));
-                   return tr_boid;
-                 });
 }
 
 void gf::update_birds(std::vector<gf::Bird>& birds,
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "simulation/config.hpp"
+#include "simulation/flock.hpp"
+#include "simulation/obstacles.hpp"
+#include "simulation/predator.hpp"
+#include "simulation/random.hpp"
+#include "simulation/trace.hpp"
+
+// Runs the simulation without graphics for a number of steps, as fast as
+// possible, and prints its throughput. Settings are read from a config file
+// (--config=FILE) and from --key=value arguments: see simulation/config.hpp
+int main(int argc, char* argv[]) {
+  // try-catch structure is used to handle exceptions
+  try {
+    cf::Config config = cf::from_args(argc, argv);
+    cf::validate(config);
+    // Spans are recorded only if compiled with BOIDS_TRACE
+    if (!config.trace.empty() && !tr::enabled) {
+      throw std::runtime_error("Cannot write " + config.trace +
+                               ": configure with -DBOIDS_TRACE=ON to record "
+                               "trace spans\n");
+    }
+    rn::set_seed(config.seed);
+
+    // -- SIMULATION OBJECTS --
+
+    mt::Vec2 space{config.width, config.height};
+    std::vector<ob::Obstacle> obstacles = ob::generate_obstacles(
+        config.obstacles, config.obstacles_max_size, space);
+
+    fk::Parameters params(config.d, config.d_s, config.s, config.a, config.c);
+    fk::Flock flock{params, config.boids, config.view_angle, space,
+                    obstacles};
+    flock.set_field_cell(config.field_cell);
+
+    std::vector<pr::Predator> predators = pr::random_predators(
+        obstacles, config.predators, space, config.pred_view_angle,
+        config.pred_ds, config.pred_s, config.pred_range, config.pred_hunger);
+
+    // -- RUN --
+
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < config.steps; ++step) {
+      flock.update_global_state(config.delta_t, config.periodic, predators,
+                                obstacles);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    // -- REPORT --
+
+    double seconds = elapsed.count();
+    double steps_per_second =
+        (seconds > 0.) ? static_cast<double>(config.steps) / seconds : 0.;
+    flock.update_stats();
+    auto const& stats = flock.get_stats();
+    std::cout << "Seed: " << config.seed << '\n'
+              << "Steps: " << config.steps << '\n'
+              << "Boids: " << config.boids << " -> " << flock.size() << '\n'
+              << "Predators: " << predators.size() << '\n'
+              << "Obstacles: " << obstacles.size() << '\n'
+              << std::fixed << std::setprecision(3)
+              << "Elapsed (s): " << seconds << '\n'
+              << std::setprecision(1) << "Steps/s: " << steps_per_second
+              << '\n'
+              << "Mean distance (px): " << stats.av_dist << " +/- "
+              << stats.dist_RMS << '\n'
+              << "Mean speed (px/s): " << stats.av_vel << " +/- "
+              << stats.vel_RMS << '\n';
+
+    if (!config.trace.empty()) {
+      std::ofstream file(config.trace);
+      if (!file) throw std::runtime_error("Cannot open " + config.trace + '\n');
+      tr::write_chrome(file);
+    }
+
+    return EXIT_SUCCESS;
+  } catch (std::exception& e) {
+    // handle standard exceptions, printing them to standard error output
+    std::cerr << e.what();
+  } catch (...) {
+    std::cerr << "Unknown exception";
+  }
+  return EXIT_FAILURE;
+}
@@ -2,6 +2,7 @@
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
 #include <execution>
@@ -15,6 +16,7 @@
 #include "graphics/bird.hpp"
 #include "simulation/boid.hpp"
 #include "simulation/flock.hpp"
+#include "simulation/histogram.hpp"
 #include "simulation/obstacles.hpp"
 #include "simulation/predator.hpp"
 
@@ -183,6 +185,10 @@ int main() {
     std::vector<ob::Obstacle> obstacles = ob::generate_obstacles(
         number_of_obstacles, obstacles_max_size,
         {static_cast<double>(video_x), static_cast<double>(video_y)});
+    // grid of obstacles, kept updated while placing new ones
+    ob::ObstacleGrid obstacle_grid;
+    obstacle_grid.build(
+        obstacles, {static_cast<double>(video_x), static_cast<double>(video_y)});
 
     // flock initialization
     fk::Flock bd_flock{
@@ -191,6 +197,8 @@ int main() {
         boids_view_angle,
         {static_cast<double>(video_x), static_cast<double>(video_y)},
         obstacles};
+    // statistics are computed by the update itself
+    bd_flock.set_stats_in_update(true);
 
     // predators initialization
     std::vector<pr::Predator> predators = pr::random_predators(
@@ -384,12 +392,12 @@ int main() {
     float pos_com_x = static_cast<float>(bd_flock.get_com().get_pos()[0]);
     float pos_com_y = static_cast<float>(bd_flock.get_com().get_pos()[1]);
     float com_angle = static_cast<float>(
-        mt::compute_angle<double>(bd_flock.get_com().get_vel()));
+        mt::compute_angle(bd_flock.get_com().get_vel()));
     float tracker_x = window_x - video_x * com_ratio - 2.f * margin;
     float tracker_y = margin;
 
     // initializes COM tracker
-    gf::Tracker com_tracker(std::valarray<float>{video_x, video_y},
+    gf::Tracker com_tracker(sf::Vector2f{video_x, video_y},
                             {pos_com_x, pos_com_y}, com_ratio, margin / 2.f);
     com_tracker.setPosition(sf::Vector2f{tracker_x, tracker_y});
     com_tracker.setFillColors(sf::Color::White, sf::Color(210, 210, 210),
@@ -400,12 +408,24 @@ int main() {
     com_tracker.update_angle(com_angle);
 
     // initializes and places text for time trackers
-    sf::Text comp_text("Computation time: \nUpdate time: \nDraw time: ", font,
-                       20);
+    sf::Text comp_text(
+        "Time (ms): p50 / p99 / max\nComputation: \nUpdate: \nDraw: ", font,
+        20);
     comp_text.setFillColor(palette[1]);
     comp_text.setPosition(video_x + 2.f * margin,
                           video_y * com_ratio + 3.f * margin);
 
+    // line of the last 120 frame times, with the 60 fps budget as reference
+    gf::Sparkline frame_line(
+        {com_tracker.getOuter().getGlobalBounds().width,
+         2.f * static_cast<float>(comp_text.getCharacterSize())},
+        120, 1000.f / 60.f);
+    frame_line.setColors(palette[1], palette[1], sf::Color(200, 60, 60));
+    frame_line.setPosition(sf::Vector2f(
+        video_x + 2.f * margin,
+        video_y * com_ratio + 3.f * margin +
+            5.5f * static_cast<float>(comp_text.getCharacterSize())));
+
     // mean speed status bar initialization
     gf::StatusBar speed_bar(
         "Number of boids: \nMean distance (px): \nMean speed (px/s): ", font,
@@ -414,8 +434,9 @@ int main() {
     speed_bar.setPosition(sf::Vector2f(
         video_x + 2.f * margin,
         video_y * com_ratio + 3.f * margin +
-            7.5f * static_cast<float>(comp_text.getCharacterSize())));
+            8.5f * static_cast<float>(comp_text.getCharacterSize())));
     // declares and initializes object for stats tracking
+    bd_flock.update_stats();
     fk::Statistics flock_stats = bd_flock.get_stats();
 
     // text for user messages
@@ -463,6 +484,16 @@ int main() {
     std::chrono::duration<double, std::milli> step_update{
         std::chrono::duration<double, std::milli>::zero()};
 
+    // histograms of the durations of each frame: computation, update, draw
+    // and whole frame. Those of the last 1200 frames are shown, those of the
+    // whole run are written on the output file on exit
+    std::array<char const*, 4> const step_names{"Computation", "Update",
+                                                "Draw", "Frame"};
+    std::array<hs::Rolling, 4> recent_times{
+        hs::Rolling(1200), hs::Rolling(1200), hs::Rolling(1200),
+        hs::Rolling(1200)};
+    std::array<hs::Histogram, 4> run_times;
+
     // stringstream for duration to string conversion
     std::ostringstream values_ss;
 
@@ -509,33 +540,27 @@ int main() {
       } else {
         // update animates in SW mode
 
-        // update graphic boids number
-        int diff = bd_flock.size() - static_cast<int>(graph_boids_sp.size());
-        if (diff > 0) {
-          for (int i = 0; i < diff; ++i) {
-            gf::Animate an_boid(
-                static_cast<float>(
-                    0.5f * margin /
-                    static_cast<float>(boid_texture_normal.getSize().x)),
-                {boid_texture_normal, boid_texture_sped});
-            graph_boids_sp.push_back(an_boid);
-          }
-        } else if (diff < 0) {
-          graph_boids_sp.erase(graph_boids_sp.begin() + bd_flock.size(),
-                               graph_boids_sp.end());
+        // update graphic boids number: animates are indexed by slot, new
+        // slots get new animates
+        while (graph_boids_sp.size() < bd_flock.get_slots()) {
+          gf::Animate an_boid(
+              static_cast<float>(
+                  0.5f * margin /
+                  static_cast<float>(boid_texture_normal.getSize().x)),
+              {boid_texture_normal, boid_texture_sped});
+          graph_boids_sp.push_back(an_boid);
         }
         // update graphic boids properties
-        assert(graph_boids_sp.size() ==
-               static_cast<unsigned int>(bd_flock.size()));
-        auto bd_indx = bd_flock.begin();
-        for (auto indx = graph_boids_sp.begin(); indx != graph_boids_sp.end();
-             ++indx) {
-          bd_indx = bd_flock.begin() + (indx - graph_boids_sp.begin());
-          indx->setPosition(static_cast<float>(bd_indx->get_pos()[0]) + margin,
-                            static_cast<float>(bd_indx->get_pos()[1]) + margin);
-          indx->setRotation(180.f - static_cast<float>(bd_indx->get_angle()));
-          (mt::vec_norm<double>(bd_indx->get_vel()) > 120.) ? indx->setState(1)
-                                                            : indx->setState(0);
+        auto const& bd_state = bd_flock.get_state();
+        for (std::size_t indx = 0; indx < bd_state.size(); ++indx) {
+          auto& sp_boid = graph_boids_sp[bd_state.slot[indx]];
+          sp_boid.setPosition(static_cast<float>(bd_state.x[indx]) + margin,
+                              static_cast<float>(bd_state.y[indx]) + margin);
+          sp_boid.setRotation(180.f -
+                              static_cast<float>(bd_state.get_angle(indx)));
+          (std::hypot(bd_state.vx[indx], bd_state.vy[indx]) > 120.)
+              ? sp_boid.setState(1)
+              : sp_boid.setState(0);
         }
 
         // update graphic predators number
@@ -562,8 +587,8 @@ int main() {
               180.f -
               static_cast<float>(
                   predators[static_cast<unsigned int>(indx)].get_angle()));
-          (mt::vec_norm<double>(
-               predators[static_cast<unsigned int>(indx)].get_vel()) > 120.)
+          (mt::vec_norm(predators[static_cast<unsigned int>(indx)].get_vel()) >
+           120.)
               ? graph_preds_sp[static_cast<unsigned int>(indx)].setState(1)
               : graph_preds_sp[static_cast<unsigned int>(indx)].setState(0);
         }
@@ -597,11 +622,10 @@ int main() {
         pos_com_y = static_cast<float>(bd_flock.get_com().get_pos()[1]);
         com_tracker.update_pos({pos_com_x, pos_com_y});
         com_angle = static_cast<float>(
-            -mt::compute_angle<double>(bd_flock.get_com().get_vel()));
+            -mt::compute_angle(bd_flock.get_com().get_vel()));
         com_tracker.update_angle(com_angle);
 
         // update stats
-        bd_flock.update_stats();
         flock_stats = bd_flock.get_stats();
         // update status bar
         speed_bar.update_value(static_cast<float>(flock_stats.av_vel));
@@ -719,7 +743,7 @@ int main() {
               // as usual, insertion time is taken into account
               init = std::chrono::steady_clock::now();
               if (add_obstacle(
-                      obstacles,
+                      obstacles, obstacle_grid,
                       {static_cast<double>(sf::Mouse::getPosition(window).x) -
                            static_cast<double>(margin),
                        static_cast<double>(sf::Mouse::getPosition(window).y) -
@@ -758,19 +782,18 @@ int main() {
         step_cmpt += std::chrono::steady_clock::now() - init;
       }
 
-      // print computation, draw and update time
+      // print percentiles of computation, update and draw time
       if (counter % 4 == 0) {
         values_ss.str("");
-        values_ss << "Computation time: " << std::setprecision(2) << std::fixed
-                  << step_cmpt.count() / 4 << " ms \n";
-        values_ss << "Update time: " << std::setprecision(2) << std::fixed
-                  << step_update.count() / 4 << " ms \n";
-        values_ss << "Draw time: " << std::setprecision(2) << std::fixed
-                  << step_draw.count() / 4 << " ms";
+        values_ss << "Time (ms): p50 / p99 / max";
+        for (std::size_t i = 0; i < 3; ++i) {
+          values_ss << '\n'
+                    << step_names[i] << ": " << std::setprecision(2)
+                    << std::fixed << recent_times[i].percentile(50.) << " / "
+                    << recent_times[i].percentile(99.) << " / "
+                    << recent_times[i].max();
+        }
         comp_text.setString(values_ss.str());
-        step_cmpt = std::chrono::duration<double, std::milli>::zero();
-        step_draw = std::chrono::duration<double, std::milli>::zero();
-        step_update = std::chrono::duration<double, std::milli>::zero();
       }
 
       // -- DRAWING --
@@ -782,16 +805,16 @@ int main() {
       // draw simulation rectangle
       window.draw(rec_sim);
       if (mode == false) {
-        // draw flock
-        for (gf::Bird& tr_boid : graph_boids_tr) {
-          window.draw(tr_boid);
+        // draw flock: only slots holding a boid
+        for (std::size_t slot = 0; slot < graph_boids_tr.size(); ++slot) {
+          if (bd_flock.is_alive(slot)) window.draw(graph_boids_tr[slot]);
         }
         // draw predators
         for (gf::Bird& tr_predator : graph_preds_tr) window.draw(tr_predator);
       } else {
-        // draw flock
-        for (gf::Animate& sp_boid : graph_boids_sp) {
-          window.draw(sp_boid);
+        // draw flock: only slots holding a boid
+        for (std::size_t slot = 0; slot < graph_boids_sp.size(); ++slot) {
+          if (bd_flock.is_alive(slot)) window.draw(graph_boids_sp[slot]);
         }
         // draw predators
         for (gf::Animate& sp_predator : graph_preds_sp)
@@ -806,6 +829,7 @@ int main() {
       window.draw(com_tracker);
       // draw time trackers
       window.draw(comp_text);
+      window.draw(frame_line);
       // draw mean speed bar + mean values (with RMSs)
       window.draw(speed_bar);
       // draw messages rectangle
@@ -827,10 +851,57 @@ int main() {
       // stop computation time 'cronometer'
       step_cmpt += std::chrono::steady_clock::now() - init;
 
+      // record the durations of the frame
+      std::array<double, 4> const durations{
+          step_cmpt.count(), step_update.count(), step_draw.count(),
+          step_cmpt.count() + step_update.count() + step_draw.count()};
+      for (std::size_t i = 0; i < durations.size(); ++i) {
+        recent_times[i].record(durations[i]);
+        run_times[i].record(durations[i]);
+      }
+      frame_line.push(static_cast<float>(durations[3]));
+      step_cmpt = std::chrono::duration<double, std::milli>::zero();
+      step_draw = std::chrono::duration<double, std::milli>::zero();
+      step_update = std::chrono::duration<double, std::milli>::zero();
+
       // increment counter
       (counter == 1200) ? counter = 0 : ++counter;
     }
 
+    // -- FRAME TIMES OUTPUT --
+
+    // percentiles of the durations of the frames, then their histograms
+    output_file << "\nFrame times (ms)\n\n"
+                << "Step         ||  Frames  ||    Mean  ||     p50  ||     "
+                   "p90  ||     p99  ||   p99.9  ||     Max\n";
+    for (std::size_t i = 0; i < run_times.size(); ++i) {
+      auto const& times = run_times[i];
+      output_file << std::setw(11) << std::left << step_names[i] << std::right
+                  << "  ||" << std::setw(8) << times.count() << "  ||"
+                  << std::setprecision(3) << std::fixed << std::setw(8)
+                  << times.mean() << "  ||" << std::setw(8)
+                  << times.percentile(50.) << "  ||" << std::setw(8)
+                  << times.percentile(90.) << "  ||" << std::setw(8)
+                  << times.percentile(99.) << "  ||" << std::setw(8)
+                  << times.percentile(99.9) << "  ||" << std::setw(8)
+                  << times.max() << '\n';
+    }
+    for (std::size_t i = 0; i < run_times.size(); ++i) {
+      output_file << '\n'
+                  << step_names[i] << " time histogram\n"
+                  << " From (ms) ||   To (ms) ||  Frames\n";
+      for (std::size_t b = 0; b < hs::Histogram::bucket_count; ++b) {
+        if (run_times[i].count(b) == 0) continue;
+        output_file << std::setprecision(3) << std::fixed << std::setw(10)
+                    << static_cast<double>(hs::Histogram::lowest(b)) / 1000.
+                    << " ||" << std::setw(10)
+                    << static_cast<double>(hs::Histogram::lowest(b) +
+                                           hs::Histogram::width(b)) /
+                           1000.
+                    << " ||" << std::setw(8) << run_times[i].count(b) << '\n';
+      }
+    }
+
     return EXIT_SUCCESS;
   } catch (std::exception& e) {
     // handle standard exceptions (for SL functions)
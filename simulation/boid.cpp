@@ -6,53 +6,58 @@
 
 #include "math.hpp"
 
-bd::Boid::Boid(std::valarray<double> pos, std::valarray<double> vel,
-               double view_ang, std::valarray<double> space, double param_ds,
-               double param_s) {
-  assert(pos.size() == 2 && vel.size() == 2 && space.size() == 2 &&
-         pos[0] >= 0. && pos[1] >= 0. && space[0] > 0. && space[1] > 0. &&
-         mt::vec_norm<double>(vel) < 350. && view_ang >= 0. &&
-         view_ang <= 180. && param_ds >= 0. && param_s >= 0.);
+bd::Boid::Boid(mt::Vec2 pos, mt::Vec2 vel, double view_ang, mt::Vec2 space,
+               double param_ds, double param_s) {
+  assert(pos[0] >= 0. && pos[1] >= 0. && space[0] > 0. && space[1] > 0. &&
+         mt::vec_norm(vel) < 350. && view_ang >= 0. && view_ang <= 180. &&
+         param_ds >= 0. && param_s >= 0.);
   b_pos = pos;
   b_vel = vel;
-  b_angle = mt::compute_angle<double>(vel);
   b_view_angle = view_ang;
+  b_cos_view = view_cosine(view_ang);
   b_space = space;
   b_param_ds = param_ds;
   b_param_s = param_s;
+  update_heading();
 }
 
 bd::Boid::Boid(double x, double y, double vx, double vy, double view_ang,
                double sx, double sy, double param_ds, double param_s) {
   assert(x >= 0. && y >= 0. && sx > 0. && sy > 0. &&
-         mt::vec_norm<double>(std::valarray<double>{vx, vy}) < 350. &&
-         view_ang >= 0. && view_ang <= 180. && param_ds >= 0. && param_s >= 0.);
-  b_pos = std::valarray<double>(2);
-  b_vel = std::valarray<double>(2);
-  b_pos[0] = x;
-  b_pos[1] = y;
-  b_vel[0] = vx;
-  b_vel[1] = vy;
-  b_angle = mt::compute_angle<double>(b_vel);
+         mt::vec_norm({vx, vy}) < 350. && view_ang >= 0. && view_ang <= 180. &&
+         param_ds >= 0. && param_s >= 0.);
+  b_pos = {x, y};
+  b_vel = {vx, vy};
   b_view_angle = view_ang;
-  b_space = std::valarray<double>{sx, sy};
+  b_cos_view = view_cosine(view_ang);
+  b_space = mt::Vec2{sx, sy};
   b_param_ds = param_ds;
   b_param_s = param_s;
+  update_heading();
 }
 
-std::valarray<double>& bd::Boid::get_pos() { return b_pos; }
+mt::Vec2& bd::Boid::get_pos() { return b_pos; }
 
-std::valarray<double> const& bd::Boid::get_pos() const { return b_pos; }
+mt::Vec2 const& bd::Boid::get_pos() const { return b_pos; }
 
-std::valarray<double>& bd::Boid::get_vel() { return b_vel; }
+mt::Vec2& bd::Boid::get_vel() { return b_vel; }
 
-std::valarray<double> const& bd::Boid::get_vel() const { return b_vel; }
+mt::Vec2 const& bd::Boid::get_vel() const { return b_vel; }
 
-double bd::Boid::get_angle() const { return b_angle; }
+double bd::Boid::get_angle() const { return mt::compute_angle(b_vel); }
+
+mt::Vec2 const& bd::Boid::get_heading() const { return b_heading; }
 
 double bd::Boid::get_view_angle() const { return b_view_angle; }
 
-std::valarray<double> const& bd::Boid::get_space() const { return b_space; }
+double bd::Boid::get_cos_view() const { return b_cos_view; }
+
+// A still boid keeps looking along the y axis, as its angle is 0
+void bd::Boid::update_heading() {
+  b_heading = (b_vel.norm2() > 0.) ? b_vel.normalized() : mt::Vec2{0., 1.};
+}
+
+mt::Vec2 const& bd::Boid::get_space() const { return b_space; }
 
 void bd::Boid::set_space(double sx, double sy) {
   assert(sx > 0 && sy > 0);
@@ -60,25 +65,22 @@ void bd::Boid::set_space(double sx, double sy) {
   b_space[1] = sy;
 }
 
-void bd::Boid::set_space(std::valarray<double> const& space) {
+void bd::Boid::set_space(mt::Vec2 const& space) {
   b_space = space;
 }
 
 // Used in a few tests implemented early
-void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel) {
+void bd::Boid::update_state(double delta_t, mt::Vec2 delta_vel) {
   // Update speed and position
   b_vel += delta_vel;
   b_pos += (b_vel * delta_t);
-  // Computes boid's angle
-  b_angle = mt::compute_angle<double>(b_vel);
   // velocità massima:
-  (mt::vec_norm<double>(b_vel) > 350.)
-      ? b_vel *= (350. / mt::vec_norm<double>(b_vel))
-      : b_vel;
+  (mt::vec_norm(b_vel) > 350.) ? b_vel *= (350. / mt::vec_norm(b_vel)) : b_vel;
+  update_heading();
 }
 
 // Update_state for tests
-void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel,
+void bd::Boid::update_state(double delta_t, mt::Vec2 delta_vel,
                             bool brd_bhv, double border_detection,
                             double border_repulsion) {
   b_vel += delta_vel;
@@ -91,7 +93,7 @@ void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel,
     (b_pos[1] < 20.) ? b_pos[1] = b_space[1] - 21. : b_pos[1];
   } else {
     // Border repulsion
-    double rep = border_repulsion * mt::vec_norm<double>(b_vel);
+    double rep = border_repulsion * mt::vec_norm(b_vel);
     (b_pos[0] > b_space[0] - 30. - border_detection * b_param_ds)
         ? b_vel[0] -= rep * b_param_s / (b_space[0] - b_pos[0])
         : b_vel[0];
@@ -106,19 +108,13 @@ void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel,
         : b_vel[1];
   }
 
-  // Computes boid's angle
-  b_angle = mt::compute_angle<double>(b_vel);
-
   // Corrects, if needed, the speed according to minimum and maximum velocity
-  (mt::vec_norm<double>(b_vel) > 350.)
-      ? b_vel *= (350. / mt::vec_norm<double>(b_vel))
-      : b_vel;
-  (mt::vec_norm<double>(b_vel) < 70.)
-      ? b_vel *= (70. / mt::vec_norm<double>(b_vel))
-      : b_vel;
+  (mt::vec_norm(b_vel) > 350.) ? b_vel *= (350. / mt::vec_norm(b_vel)) : b_vel;
+  (mt::vec_norm(b_vel) < 70.) ? b_vel *= (70. / mt::vec_norm(b_vel)) : b_vel;
+  update_heading();
 }
 
-void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel,
+void bd::Boid::update_state(double delta_t, mt::Vec2 delta_vel,
                             bool brd_bhv) {
   b_vel += delta_vel;
   b_pos += (b_vel * delta_t);
@@ -130,7 +126,7 @@ void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel,
     (b_pos[1] < 20.) ? b_pos[1] = b_space[1] - 21. : b_pos[1];
   } else {
     // Border repulsion
-    double rep = 2.4 * mt::vec_norm<double>(b_vel) + 10;
+    double rep = 2.4 * mt::vec_norm(b_vel) + 10;
     (b_pos[0] > b_space[0] - 20. - 9. * b_param_ds)
         ? b_vel[0] -= rep * b_param_s /
                       std::abs(b_pos[0] - b_space[0] + 20. + 2.5 * b_param_ds)
@@ -149,101 +145,98 @@ void bd::Boid::update_state(double delta_t, std::valarray<double> delta_vel,
         : b_vel[1];
   }
 
-  // Computes boid's angle
-  b_angle = mt::compute_angle<double>(b_vel);
-
   // Corrects, if needed, the speed according to minimum and maximum velocity
-  (mt::vec_norm<double>(b_vel) > 350.)
-      ? b_vel *= (350. / mt::vec_norm<double>(b_vel))
-      : b_vel;
-  (mt::vec_norm<double>(b_vel) < 70.)
-      ? b_vel *= (90. / mt::vec_norm<double>(b_vel))
-      : b_vel;
+  (mt::vec_norm(b_vel) > 350.) ? b_vel *= (350. / mt::vec_norm(b_vel)) : b_vel;
+  (mt::vec_norm(b_vel) < 70.) ? b_vel *= (90. / mt::vec_norm(b_vel)) : b_vel;
+  update_heading();
 }
 
-// Avoid_obs for tests
-std::valarray<double> bd::Boid::avoid_obs(
-    std::vector<ob::Obstacle> const& obstacles, double obstacle_detection,
-    double obstacle_repulsion) const {
-  if (obstacles.size() == 0) {
-    return std::valarray<double>{0., 0.};
-  } else {
-    std::valarray<double> delta_vel{0., 0.};
-    // for each obstacles, it checks wheter the bois is or not near it and
-    // wheter or not it sees it. In case it applies a repulsion inverse to the
-    // distace for each componenent
-    double rep = obstacle_repulsion * mt::vec_norm<double>(b_vel);
-    for (auto const& ob : obstacles) {
-      double range = ob.get_size() + obstacle_detection * b_param_ds;
-      ((b_pos[0] - ob.get_pos()[0]) > 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[0] += rep * b_param_s / (b_pos[0] - ob.get_pos()[0])
-          : delta_vel[0];
-
-      ((b_pos[0] - ob.get_pos()[0]) < 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[0] -= rep * b_param_s / (ob.get_pos()[0] - b_pos[0])
-          : delta_vel[0];
-
-      ((b_pos[1] - ob.get_pos()[1]) > 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[1] += rep * b_param_s / (b_pos[1] - ob.get_pos()[1])
-          : delta_vel[1];
-
-      ((b_pos[1] - ob.get_pos()[1]) < 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[1] -= rep * b_param_s / (ob.get_pos()[1] - b_pos[1])
-          : delta_vel[1];
-    }
+// Same as the default update_state, with the border repulsion pointing away
+// from the nearest border
+void bd::Boid::update_state(double delta_t, mt::Vec2 delta_vel, bool brd_bhv,
+                            df::Field const& field) {
+  if (brd_bhv == true) {
+    // Periodic conditions do not use the field
+    update_state(delta_t, delta_vel, brd_bhv);
+    return;
+  }
+  b_vel += delta_vel;
+  b_pos += (b_vel * delta_t);
+  df::Sample near = field.borders_at(b_pos);
+  if (near.dist < 9. * b_param_ds + 20.) {
+    double rep = 2.4 * mt::vec_norm(b_vel) + 10;
+    b_vel += rep * b_param_s /
+             std::max(std::abs(near.dist - 2.5 * b_param_ds - 20.), 1.) *
+             near.grad;
+  }
+
+  (mt::vec_norm(b_vel) > 350.) ? b_vel *= (350. / mt::vec_norm(b_vel)) : b_vel;
+  (mt::vec_norm(b_vel) < 70.) ? b_vel *= (90. / mt::vec_norm(b_vel)) : b_vel;
+  update_heading();
+}
+
+// It checks wheter the boid is or not near the obstacle and wheter or not it
+// sees it. In case it applies a repulsion inverse to the distance for each
+// component. Distance and visibility are computed once per obstacle
+mt::Vec2 bd::Boid::repulsion_from(ob::Obstacle const& ob,
+                                  double obstacle_detection,
+                                  double rep) const {
+  double range = ob.get_size() + obstacle_detection * b_param_ds;
+  mt::Vec2 rel = b_pos - ob.get_pos();
+  mt::Vec2 delta_vel{0., 0.};
+  if (rel.norm() >= range || !in_view(-rel.x, -rel.y, b_heading, b_cos_view)) {
     return delta_vel;
   }
+  // The repulsion on each component points away from the obstacle
+  (rel.x != 0.) ? delta_vel.x = rep * b_param_s / rel.x : delta_vel.x;
+  (rel.y != 0.) ? delta_vel.y = rep * b_param_s / rel.y : delta_vel.y;
+  return delta_vel;
 }
 
-std::valarray<double> bd::Boid::avoid_obs(
+// Avoid_obs for tests
+mt::Vec2 bd::Boid::avoid_obs(std::vector<ob::Obstacle> const& obstacles,
+                             double obstacle_detection,
+                             double obstacle_repulsion) const {
+  mt::Vec2 delta_vel{0., 0.};
+  double rep = obstacle_repulsion * mt::vec_norm(b_vel);
+  for (auto const& ob : obstacles) {
+    delta_vel += repulsion_from(ob, obstacle_detection, rep);
+  }
+  return delta_vel;
+}
+
+mt::Vec2 bd::Boid::avoid_obs(
     std::vector<ob::Obstacle> const& obstacles) const {
-  if (obstacles.size() == 0) {
-    return std::valarray<double>{0., 0.};
-  } else {
-    std::valarray<double> delta_vel{0., 0.};
-
-    // for each obstacles, it checks wheter the bois is or not near it and
-    // wheter or not it sees it. In case it applies a repulsion inverse to the
-    // distace for each componenent
-
-    double rep = 1.9 * mt::vec_norm<double>(b_vel);
-    for (auto const& ob : obstacles) {
-      double range = ob.get_size() + 2.7 * b_param_ds;
-
-      ((b_pos[0] - ob.get_pos()[0]) > 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[0] += rep * b_param_s / (b_pos[0] - ob.get_pos()[0])
-          : delta_vel[0];
-
-      ((b_pos[0] - ob.get_pos()[0]) < 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[0] -= rep * b_param_s / (ob.get_pos()[0] - b_pos[0])
-          : delta_vel[0];
-
-      ((b_pos[1] - ob.get_pos()[1]) > 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[1] += rep * b_param_s / (b_pos[1] - ob.get_pos()[1])
-          : delta_vel[1];
-
-      ((b_pos[1] - ob.get_pos()[1]) < 0 &&
-       mt::vec_norm<double>(b_pos - ob.get_pos()) < range &&
-       is_obs_visible(ob, *this))
-          ? delta_vel[1] -= rep * b_param_s / (ob.get_pos()[1] - b_pos[1])
-          : delta_vel[1];
-    }
-    return delta_vel;
+  return avoid_obs(obstacles, 2.7, 1.9);
+}
+
+mt::Vec2 bd::Boid::avoid_obs(ob::ObstacleGrid const& obstacles,
+                             double obstacle_detection,
+                             double obstacle_repulsion) const {
+  mt::Vec2 delta_vel{0., 0.};
+  double rep = obstacle_repulsion * mt::vec_norm(b_vel);
+  obstacles.for_each_near(b_pos, obstacle_detection * b_param_ds,
+                          [&](ob::Obstacle const& ob) {
+                            delta_vel += repulsion_from(ob, obstacle_detection,
+                                                        rep);
+                          });
+  return delta_vel;
+}
+
+mt::Vec2 bd::Boid::avoid_obs(ob::ObstacleGrid const& obstacles) const {
+  return avoid_obs(obstacles, 2.7, 1.9);
+}
+
+// The repulsion points away from the nearest obstacle, if the boid sees it,
+// and decreases with the distance from its surface
+mt::Vec2 bd::Boid::avoid_obs(df::Field const& field) const {
+  df::Sample near = field.obstacles_at(b_pos);
+  if (near.dist >= 2.7 * b_param_ds ||
+      !in_view(-near.grad.x, -near.grad.y, b_heading, b_cos_view)) {
+    return mt::Vec2{0., 0.};
   }
+  double rep = 1.9 * mt::vec_norm(b_vel);
+  return rep * b_param_s / (std::max(near.dist, 0.) + b_param_ds) * near.grad;
 }
 
 double bd::Boid::get_par_ds() const { return b_param_ds; }
@@ -254,18 +247,35 @@ void bd::Boid::set_par_ds(double new_ds) { b_param_ds = new_ds; }
 
 void bd::Boid::set_par_s(double new_s) { b_param_s = new_s; }
 
+void bd::Boid::set_state(double x, double y, double vx, double vy) {
+  b_pos = {x, y};
+  b_vel = {vx, vy};
+  update_heading();
+}
+
 double bd::boid_dist(bd::Boid const& bd_1, bd::Boid const& bd_2) {
-  return mt::vec_norm<double>(bd_1.get_pos() - bd_2.get_pos());
+  return mt::vec_norm(bd_1.get_pos() - bd_2.get_pos());
+}
+
+double bd::view_cosine(double view_angle) {
+  assert(view_angle >= 0. && view_angle <= 180.);
+  return (view_angle >= 180.) ? -2.
+                              : std::cos(view_angle / 180. * M_PI) - 1e-12;
 }
 
 // If bd_1 is visible by bd_2, it returns true
 bool bd::is_visible(bd::Boid const& bd_1, bd::Boid const& bd_2) {
-  double view_angle = bd_2.get_view_angle();
-  double boid_angle = bd_2.get_angle();
+  mt::Vec2 rel = bd_1.get_pos() - bd_2.get_pos();
+  return bd::in_view(rel.x, rel.y, bd_2.get_heading(), bd_2.get_cos_view());
+}
+
+// If a point at relative position rel is seen by a boid with given angle and
+// view_angle, it returns true
+bool bd::is_visible(mt::Vec2 const& rel, double boid_angle,
+                    double view_angle) {
   assert(view_angle >= 0. && view_angle <= 180.);
 
-  double relative_angle =
-      mt::compute_angle<double>(bd_1.get_pos() - bd_2.get_pos());
+  double relative_angle = mt::compute_angle(rel);
 
   if (std::abs(relative_angle - boid_angle) <= 180.) {
     return std::abs(relative_angle - boid_angle) <= view_angle;
@@ -276,47 +286,18 @@ bool bd::is_visible(bd::Boid const& bd_1, bd::Boid const& bd_2) {
 
 // If obs is visible by bd, it returns true
 bool bd::is_obs_visible(ob::Obstacle const& obs, bd::Boid const& bd) {
-  double view_angle = bd.get_view_angle();
-
-  assert(view_angle >= 0. && view_angle <= 180.);
-  double relative_angle =
-      mt::compute_angle<double>(obs.get_pos() - bd.get_pos());
-
-  if (std::abs(relative_angle - bd.get_angle()) <= 180.) {
-    return std::abs(relative_angle - bd.get_angle()) <= view_angle;
-  } else {
-    return (360. - std::abs(relative_angle - bd.get_angle())) <= view_angle;
-  }
+  mt::Vec2 rel = obs.get_pos() - bd.get_pos();
+  return bd::in_view(rel.x, rel.y, bd.get_heading(), bd.get_cos_view());
 }
 
 // Given a vector and an iterator, it finds all of its neighbours, with the
 // condition that the vector is SORTED
 std::vector<bd::Boid> bd::get_vector_neighbours(
-    std::vector<bd::Boid> const& full_vec, std::vector<bd::Boid>::iterator it,
-    double dist) {
+    std::vector<bd::Boid> const& full_vec,
+    std::vector<bd::Boid>::const_iterator it, double dist) {
   std::vector<bd::Boid> neighbours;
-  assert(it >= full_vec.begin() && it <= full_vec.end());
-  if (it >= full_vec.begin() && it < full_vec.end()) {
-    auto et = it;
-    for (; et != full_vec.end(); ++et) {
-      if (std::abs(it->get_pos()[0] - et->get_pos()[0]) > dist) break;
-      if (boid_dist(*et, *it) < dist && boid_dist(*et, *it) > 0. &&
-          is_visible(*et, *it) == true) {
-        neighbours.push_back(*et);
-      }
-    }
-    et = it;
-    for (; et != full_vec.begin(); --et) {
-      if (std::abs(it->get_pos()[0] - et->get_pos()[0]) > dist) break;
-      if (boid_dist(*et, *it) < dist && boid_dist(*et, *it) > 0. &&
-          is_visible(*et, *it) == true) {
-        neighbours.push_back(*et);
-      }
-    }
-    if (boid_dist(*et, *it) < dist && boid_dist(*et, *it) > 0. &&
-        is_visible(*et, *it) == true) {
-      neighbours.push_back(*et);
-    }
-  }
+  for_each_neighbour(full_vec, it, dist, [&neighbours](bd::Boid const& bd) {
+    neighbours.push_back(bd);
+  });
   return neighbours;
-}
\ No newline at end of file
+}
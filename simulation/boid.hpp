@@ -2,61 +2,129 @@
 #define BOID_HPP
 
 #include <cassert>
+#include <vector>
 
+#include "field.hpp"
 #include "math.hpp"
 #include "obstacles.hpp"
 
 namespace bd {
 class Boid {
-  std::valarray<double> b_pos;
-  std::valarray<double> b_vel;
-  double b_angle;
+  mt::Vec2 b_pos;
+  mt::Vec2 b_vel;
+  // Unit vector along the velocity and cosine of the view angle, used to
+  // check visibility without computing angles
+  mt::Vec2 b_heading;
   double b_view_angle;
-  std::valarray<double> b_space;
+  double b_cos_view;
+  mt::Vec2 b_space;
   double b_param_ds;
   double b_param_s;
 
+  void update_heading();
+  // Repulsion from an obstacle, if it is visible and closer than its size plus
+  // detection times d_s
+  mt::Vec2 repulsion_from(ob::Obstacle const&, double, double) const;
+
  public:
-  Boid(std::valarray<double>, std::valarray<double>, double,
-       std::valarray<double>, double, double);
+  Boid(mt::Vec2, mt::Vec2, double, mt::Vec2, double, double);
   Boid(double, double, double, double, double, double, double, double, double);
   Boid() = default;
 
-  std::valarray<double>& get_pos();
-  std::valarray<double> const& get_pos() const;
+  mt::Vec2& get_pos();
+  mt::Vec2 const& get_pos() const;
 
-  std::valarray<double>& get_vel();
-  std::valarray<double> const& get_vel() const;
+  mt::Vec2& get_vel();
+  mt::Vec2 const& get_vel() const;
 
+  // Angle of the velocity in degrees, computed when asked (for rendering)
   double get_angle() const;
+  mt::Vec2 const& get_heading() const;
   double get_view_angle() const;
+  double get_cos_view() const;
 
-  std::valarray<double> const& get_space() const;
+  mt::Vec2 const& get_space() const;
   void set_space(double, double);
-  void set_space(std::valarray<double> const&);
+  void set_space(mt::Vec2 const&);
 
   double get_par_ds() const;
   double get_par_s() const;
   void set_par_ds(double);
   void set_par_s(double);
 
+  // Overwrites position and velocity without any check: used to rebuild a
+  // boid from the flock storage
+  void set_state(double, double, double, double);
+
   // Avoid_obs for tests
-  std::valarray<double> avoid_obs(std::vector<ob::Obstacle> const&, double,
-                                  double) const;
-  std::valarray<double> avoid_obs(std::vector<ob::Obstacle> const&) const;
+  mt::Vec2 avoid_obs(std::vector<ob::Obstacle> const&, double, double) const;
+  mt::Vec2 avoid_obs(std::vector<ob::Obstacle> const&) const;
+  // avoid_obs looking only at the obstacles near the boid
+  mt::Vec2 avoid_obs(ob::ObstacleGrid const&, double, double) const;
+  mt::Vec2 avoid_obs(ob::ObstacleGrid const&) const;
+  // avoid_obs and update_state with border repulsion reading a distance field
+  // instead of the obstacles: they approximate the default ones
+  mt::Vec2 avoid_obs(df::Field const&) const;
+  void update_state(double, mt::Vec2, bool, df::Field const&);
 
-  void update_state(double, std::valarray<double>);
-  void update_state(double, std::valarray<double>, bool);
+  void update_state(double, mt::Vec2);
+  void update_state(double, mt::Vec2, bool);
   // update_state for tests
-  void update_state(double, std::valarray<double>, bool, double, double);
+  void update_state(double, mt::Vec2, bool, double, double);
 };
 
 double boid_dist(Boid const& bd_1, Boid const& bd_2);
 
+// Cosine of the view angle used by the heading-based visibility test. It is
+// lowered by a tiny amount, so that points lying exactly on the border of the
+// view cone stay visible despite rounding; a full view gives a value below -1
+double view_cosine(double);
+
+// Trig-free visibility: rel (relative position of the target) lies inside the
+// cone of cosine cos_view around the unit vector heading
+inline bool in_view(double rel_x, double rel_y, mt::Vec2 const& heading,
+                    double cos_view) {
+  return heading.x * rel_x + heading.y * rel_y >=
+         cos_view * std::sqrt(rel_x * rel_x + rel_y * rel_y);
+}
+
 bool is_visible(Boid const&, Boid const&);
+// is_visible on raw data, comparing angles: relative position of the target,
+// angle and view angle of the observer
+bool is_visible(mt::Vec2 const&, double, double);
 bool is_obs_visible(ob::Obstacle const& obs, Boid const& bd);
 
+// Calls f(neighbour) for each neighbour of *it within dist, with the condition
+// that the vector is SORTED. It works for boids and predators and it doesn't
+// copy or allocate anything
+template <typename T, typename F>
+void for_each_neighbour(std::vector<T> const& vec,
+                        typename std::vector<T>::const_iterator it, double dist,
+                        F&& f) {
+  assert(it >= vec.begin() && it <= vec.end());
+  if (it == vec.end()) return;
+  auto is_neighbour = [&it, dist](T const& other) {
+    double dx = other.get_pos()[0] - it->get_pos()[0];
+    double dy = other.get_pos()[1] - it->get_pos()[1];
+    double other_dist = std::sqrt(dx * dx + dy * dy);
+    return other_dist < dist && other_dist > 0. &&
+           in_view(dx, dy, it->get_heading(), it->get_cos_view());
+  };
+  // It checks elements to the right and to the left, until the distance on x
+  // axis becomes larger than dist
+  for (auto et = it + 1; et != vec.end(); ++et) {
+    if (std::abs(it->get_pos()[0] - et->get_pos()[0]) > dist) break;
+    if (is_neighbour(*et)) f(*et);
+  }
+  for (auto et = it; et != vec.begin(); --et) {
+    auto prev = et - 1;
+    if (std::abs(it->get_pos()[0] - prev->get_pos()[0]) > dist) break;
+    if (is_neighbour(*prev)) f(*prev);
+  }
+}
+
 std::vector<Boid> get_vector_neighbours(std::vector<Boid> const&,
-                                        std::vector<Boid>::iterator, double);
+                                        std::vector<Boid>::const_iterator,
+                                        double);
 }  // namespace bd
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "config.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "flock.hpp"
+
+namespace {
+// Reads the whole text as a value, failing on trailing characters
+template <typename T>
+T parse(std::string const& key, std::string const& text) {
+  std::istringstream stream(text);
+  T value{};
+  stream >> std::boolalpha >> value;
+  if (stream.fail() || !(stream >> std::ws).eof()) {
+    throw std::runtime_error("Invalid value for " + key + ": " + text + '\n');
+  }
+  return value;
+}
+
+std::string trim(std::string const& text) {
+  auto first = text.find_first_not_of(" \t\r");
+  if (first == std::string::npos) return "";
+  auto last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+
+void check(bool valid, std::string const& key) {
+  if (!valid) throw std::runtime_error("Invalid parameter " + key + '\n');
+}
+}  // namespace
+
+void cf::set(Config& config, std::string const& key,
+             std::string const& value) {
+  if (key == "boids") {
+    config.boids = parse<int>(key, value);
+  } else if (key == "d") {
+    config.d = parse<double>(key, value);
+  } else if (key == "d_s") {
+    config.d_s = parse<double>(key, value);
+  } else if (key == "s") {
+    config.s = parse<double>(key, value);
+  } else if (key == "a") {
+    config.a = parse<double>(key, value);
+  } else if (key == "c") {
+    config.c = parse<double>(key, value);
+  } else if (key == "view_angle") {
+    config.view_angle = parse<double>(key, value);
+  } else if (key == "obstacles") {
+    config.obstacles = parse<int>(key, value);
+  } else if (key == "obstacles_max_size") {
+    config.obstacles_max_size = parse<double>(key, value);
+  } else if (key == "predators") {
+    config.predators = parse<int>(key, value);
+  } else if (key == "pred_view_angle") {
+    config.pred_view_angle = parse<double>(key, value);
+  } else if (key == "pred_ds") {
+    config.pred_ds = parse<double>(key, value);
+  } else if (key == "pred_s") {
+    config.pred_s = parse<double>(key, value);
+  } else if (key == "pred_range") {
+    config.pred_range = parse<double>(key, value);
+  } else if (key == "pred_hunger") {
+    config.pred_hunger = parse<double>(key, value);
+  } else if (key == "width") {
+    config.width = parse<double>(key, value);
+  } else if (key == "height") {
+    config.height = parse<double>(key, value);
+  } else if (key == "periodic") {
+    config.periodic = parse<bool>(key, value);
+  } else if (key == "steps") {
+    config.steps = parse<int>(key, value);
+  } else if (key == "delta_t") {
+    config.delta_t = parse<double>(key, value);
+  } else if (key == "seed") {
+    config.seed = parse<std::uint64_t>(key, value);
+  } else if (key == "field_cell") {
+    config.field_cell = parse<double>(key, value);
+  } else if (key == "trace") {
+    config.trace = parse<std::string>(key, value);
+  } else {
+    throw std::runtime_error("Unknown parameter " + key + '\n');
+  }
+}
+
+void cf::read(Config& config, std::istream& input) {
+  std::string line;
+  while (std::getline(input, line)) {
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) continue;
+    auto equal = line.find('=');
+    if (equal == std::string::npos) {
+      throw std::runtime_error("Invalid line: " + line + '\n');
+    }
+    set(config, trim(line.substr(0, equal)), trim(line.substr(equal + 1)));
+  }
+}
+
+cf::Config cf::from_args(int argc, char const* const* argv) {
+  Config config;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto equal = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equal == std::string::npos) {
+      throw std::runtime_error("Invalid argument " + arg + '\n');
+    }
+    std::string key = arg.substr(2, equal - 2);
+    std::string value = arg.substr(equal + 1);
+    if (key == "config") {
+      std::ifstream file(value);
+      if (!file) throw std::runtime_error("Cannot open " + value + '\n');
+      read(config, file);
+    } else {
+      set(config, key, value);
+    }
+  }
+  return config;
+}
+
+// Same ranges as the interactive programme, except that predators and
+// obstacles can be missing
+void cf::validate(Config const& config) {
+  check(config.boids > 0, "boids");
+  check(config.d > 20. && config.d <= 100., "d");
+  check(config.d_s >= 10. && config.d_s <= 25. && config.d_s <= config.d,
+        "d_s");
+  check(config.s > 0. && config.s <= 1.5, "s");
+  check(config.a >= 0.1 && config.a <= 0.5, "a");
+  check(config.c >= 0. && config.c <= 0.1, "c");
+  check(config.view_angle >= 0. && config.view_angle <= 180., "view_angle");
+  check(config.obstacles >= 0, "obstacles");
+  check(config.obstacles_max_size > 15. && config.obstacles_max_size <= 70.,
+        "obstacles_max_size");
+  check(config.predators >= 0, "predators");
+  check(config.pred_view_angle > 0. && config.pred_view_angle <= 180.,
+        "pred_view_angle");
+  check(config.pred_ds > 0. && config.pred_ds <= 50., "pred_ds");
+  check(config.pred_s > 0. && config.pred_s <= 2., "pred_s");
+  check(config.pred_range > 0. && config.pred_range <= 90., "pred_range");
+  check(config.pred_hunger > 0. && config.pred_hunger <= 2., "pred_hunger");
+  // Obstacles are generated at least 4.5 times their size from the borders
+  check(config.width > 9. * config.obstacles_max_size + 40., "width");
+  check(config.height > 9. * config.obstacles_max_size + 40., "height");
+  check(config.steps >= 0, "steps");
+  check(config.delta_t > 0., "delta_t");
+  check(config.field_cell >= 0., "field_cell");
+  // The flock must fit in the space, whatever the obstacles generated
+  auto const capacity =
+      fk::max_boids(config.d_s, {config.width, config.height},
+                    config.obstacles, config.obstacles_max_size);
+  if (static_cast<std::size_t>(config.boids) > capacity) {
+    throw std::runtime_error("Invalid parameter boids: at most " +
+                             std::to_string(capacity) +
+                             " fit in the space\n");
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <cstdint>
+#include <istream>
+#include <string>
+
+namespace cf {
+// Settings of a simulation run without graphics. Defaults are the
+// recommended values of the interactive programme
+struct Config {
+  // Flock
+  int boids{1000};
+  double d{50.};
+  double d_s{20.};
+  double s{1.2};
+  double a{0.1};
+  double c{0.01};
+  double view_angle{120.};
+  // Obstacles
+  int obstacles{10};
+  double obstacles_max_size{20.};
+  // Predators
+  int predators{5};
+  double pred_view_angle{140.};
+  double pred_ds{30.};
+  double pred_s{1.};
+  double pred_range{70.};
+  double pred_hunger{1.2};
+  // Space and borders: periodic conditions or border repulsion
+  double width{1440.};
+  double height{950.};
+  bool periodic{false};
+  // Run
+  int steps{1000};
+  double delta_t{0.0166};
+  std::uint64_t seed{1};
+  double field_cell{0.};
+  // File where the trace of the last steps is written, if not empty
+  std::string trace{};
+};
+
+// Sets the setting named key from its text. Throws std::runtime_error if the
+// key is unknown or the value can't be read
+void set(Config&, std::string const&, std::string const&);
+
+// Reads "key = value" lines into a configuration; empty lines and text after
+// '#' are ignored
+void read(Config&, std::istream&);
+
+// Configuration from the command line: --config=FILE reads a file, then
+// each --key=value overrides a setting, in order
+Config from_args(int, char const* const*);
+
+// Throws std::runtime_error if a setting is out of its range, or if the
+// boids may not fit in the space with the obstacles
+void validate(Config const&);
+}  // namespace cf
+
+#endif
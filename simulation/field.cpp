@@ -0,0 +1,104 @@
+#include "field.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+void df::Field::build(ob::ObstacleGrid const& obstacles,
+                      mt::Vec2 const& space, double cell, double reach) {
+  assert(space[0] > 0. && space[1] > 0. && cell > 0. && reach > 0.);
+  f_cell = cell;
+  f_reach = reach;
+  // The lattice covers the whole space, so there are at least 2 x 2 nodes
+  f_cols = static_cast<std::size_t>(std::ceil(space[0] / cell)) + 1;
+  f_rows = static_cast<std::size_t>(std::ceil(space[1] / cell)) + 1;
+  f_obstacles.dist.resize(f_cols * f_rows);
+  f_borders.dist.resize(f_cols * f_rows);
+
+  std::vector<std::size_t> rows(f_rows);
+  std::iota(rows.begin(), rows.end(), std::size_t{0});
+  std::for_each(std::execution::par, rows.begin(), rows.end(),
+                [&](std::size_t r) {
+                  for (std::size_t c = 0; c < f_cols; ++c) {
+                    mt::Vec2 node{static_cast<double>(c) * cell,
+                                  static_cast<double>(r) * cell};
+                    double dist = reach;
+                    obstacles.for_each_near(
+                        node, reach, [&](ob::Obstacle const& obs) {
+                          double to_obs = mt::vec_norm(node - obs.get_pos()) -
+                                          obs.get_size();
+                          dist = std::min(dist, to_obs);
+                        });
+                    f_obstacles.dist[r * f_cols + c] = dist;
+                    f_borders.dist[r * f_cols + c] =
+                        std::min({node.x, node.y, space[0] - node.x,
+                                  space[1] - node.y, reach});
+                  }
+                });
+  compute_gradient(f_obstacles, rows);
+  compute_gradient(f_borders, rows);
+}
+
+void df::Field::compute_gradient(Layer& layer,
+                                 std::vector<std::size_t> const& rows) const {
+  layer.grad_x.resize(layer.dist.size());
+  layer.grad_y.resize(layer.dist.size());
+  // Central differences, one-sided on the edges of the lattice
+  auto derivative = [this](double before, double after, std::size_t steps) {
+    return (after - before) / (static_cast<double>(steps) * f_cell);
+  };
+  std::for_each(std::execution::par, rows.begin(), rows.end(),
+                [&](std::size_t r) {
+                  std::size_t r_0 = (r > 0) ? r - 1 : r;
+                  std::size_t r_1 = (r + 1 < f_rows) ? r + 1 : r;
+                  for (std::size_t c = 0; c < f_cols; ++c) {
+                    std::size_t c_0 = (c > 0) ? c - 1 : c;
+                    std::size_t c_1 = (c + 1 < f_cols) ? c + 1 : c;
+                    layer.grad_x[r * f_cols + c] = derivative(
+                        layer.dist[r * f_cols + c_0],
+                        layer.dist[r * f_cols + c_1], c_1 - c_0);
+                    layer.grad_y[r * f_cols + c] = derivative(
+                        layer.dist[r_0 * f_cols + c],
+                        layer.dist[r_1 * f_cols + c], r_1 - r_0);
+                  }
+                });
+}
+
+bool df::Field::empty() const { return f_obstacles.dist.empty(); }
+
+double df::Field::get_cell_size() const { return f_cell; }
+
+double df::Field::get_reach() const { return f_reach; }
+
+df::Sample df::Field::sample(Layer const& layer, mt::Vec2 const& pos) const {
+  assert(!empty());
+  // Lattice cell containing pos (positions outside are clamped) and
+  // coordinates of pos inside it
+  double u = std::clamp(pos.x / f_cell, 0., static_cast<double>(f_cols - 1));
+  double v = std::clamp(pos.y / f_cell, 0., static_cast<double>(f_rows - 1));
+  std::size_t c = std::min(static_cast<std::size_t>(u), f_cols - 2);
+  std::size_t r = std::min(static_cast<std::size_t>(v), f_rows - 2);
+  double tx = u - static_cast<double>(c);
+  double ty = v - static_cast<double>(r);
+
+  auto bilinear = [&](std::vector<double> const& values) {
+    return (values[r * f_cols + c] * (1. - tx) +
+            values[r * f_cols + c + 1] * tx) *
+               (1. - ty) +
+           (values[(r + 1) * f_cols + c] * (1. - tx) +
+            values[(r + 1) * f_cols + c + 1] * tx) *
+               ty;
+  };
+  mt::Vec2 grad{bilinear(layer.grad_x), bilinear(layer.grad_y)};
+  return Sample{bilinear(layer.dist), grad.normalized()};
+}
+
+df::Sample df::Field::obstacles_at(mt::Vec2 const& pos) const {
+  return sample(f_obstacles, pos);
+}
+
+df::Sample df::Field::borders_at(mt::Vec2 const& pos) const {
+  return sample(f_borders, pos);
+}
@@ -0,0 +1,52 @@
+#ifndef FIELD_HPP
+#define FIELD_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "math.hpp"
+#include "obstacles.hpp"
+
+namespace df {
+// Distance from the nearest surface and unit vector pointing away from it
+struct Sample {
+  double dist;
+  mt::Vec2 grad;
+};
+
+// Distance fields of the obstacles and of the borders of the space, sampled on
+// a square lattice and interpolated bilinearly. Distances are positive outside
+// the obstacles and inside the space, and capped at a maximum reach: beyond it
+// the gradient is null
+class Field {
+  double f_cell{1.};
+  double f_reach{0.};
+  // Number of lattice nodes per row and per column
+  std::size_t f_cols{0};
+  std::size_t f_rows{0};
+  // Distance and its gradient (central differences) at the lattice nodes
+  struct Layer {
+    std::vector<double> dist;
+    std::vector<double> grad_x;
+    std::vector<double> grad_y;
+  };
+  Layer f_obstacles;
+  Layer f_borders;
+
+  void compute_gradient(Layer&, std::vector<std::size_t> const&) const;
+  Sample sample(Layer const&, mt::Vec2 const&) const;
+
+ public:
+  // Rasterises the fields, one row of nodes per task. Takes: obstacles, space,
+  // lattice spacing, reach
+  void build(ob::ObstacleGrid const&, mt::Vec2 const&, double, double);
+  bool empty() const;
+  double get_cell_size() const;
+  double get_reach() const;
+
+  Sample obstacles_at(mt::Vec2 const&) const;
+  Sample borders_at(mt::Vec2 const&) const;
+};
+}  // namespace df
+
+#endif
@@ -2,12 +2,17 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <execution>
-#include <mutex>
 #include <numeric>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <utility>
 
+#include "random.hpp"
+
 // Statistics constructor
 fk::Statistics::Statistics(double mean_dist, double rms_dist, double mean_vel,
                            double rms_vel) {
@@ -29,11 +34,247 @@ fk::Parameters::Parameters(double p_d, double p_ds, double p_s, double p_a,
   c = p_c;
 }
 
+// FLOCK STATE
+
+std::size_t fk::FlockState::size() const { return x.size(); }
+
+double fk::FlockState::get_angle(std::size_t i) const {
+  assert(i < size());
+  return mt::compute_angle(vx[i], vy[i]);
+}
+
+void fk::FlockState::reserve(std::size_t n) {
+  x.reserve(n);
+  y.reserve(n);
+  vx.reserve(n);
+  vy.reserve(n);
+  slot.reserve(n);
+}
+
+void fk::FlockState::clear() {
+  x.clear();
+  y.clear();
+  vx.clear();
+  vy.clear();
+  slot.clear();
+}
+
+void fk::FlockState::resize(std::size_t n) {
+  x.resize(n);
+  y.resize(n);
+  vx.resize(n);
+  vy.resize(n);
+  slot.resize(n);
+}
+
+void fk::FlockState::swap(fk::FlockState& other) {
+  x.swap(other.x);
+  y.swap(other.y);
+  vx.swap(other.vx);
+  vy.swap(other.vy);
+  slot.swap(other.slot);
+}
+
+void fk::FlockState::swap_motion(fk::FlockState& other) {
+  x.swap(other.x);
+  y.swap(other.y);
+  vx.swap(other.vx);
+  vy.swap(other.vy);
+}
+
+void fk::FlockState::push_back(bd::Boid const& boid) {
+  push_back(boid, size());
+}
+
+void fk::FlockState::push_back(bd::Boid const& boid, std::size_t s) {
+  x.push_back(boid.get_pos()[0]);
+  y.push_back(boid.get_pos()[1]);
+  vx.push_back(boid.get_vel()[0]);
+  vy.push_back(boid.get_vel()[1]);
+  slot.push_back(s);
+}
+
+void fk::FlockState::set(std::size_t i, bd::Boid const& boid) {
+  assert(i < size());
+  x[i] = boid.get_pos()[0];
+  y[i] = boid.get_pos()[1];
+  vx[i] = boid.get_vel()[0];
+  vy[i] = boid.get_vel()[1];
+}
+
+void fk::FlockState::erase(std::size_t i) {
+  assert(i < size());
+  auto offset = static_cast<std::ptrdiff_t>(i);
+  x.erase(x.begin() + offset);
+  y.erase(y.begin() + offset);
+  vx.erase(vx.begin() + offset);
+  vy.erase(vy.begin() + offset);
+  slot.erase(slot.begin() + offset);
+}
+
+void fk::FlockState::permute(std::vector<std::size_t> const& indexes) {
+  // Each array is gathered in a new one and then swapped in: boids not listed
+  // in indexes are dropped
+  auto gather = [&indexes](auto& values) {
+    std::remove_reference_t<decltype(values)> gathered(indexes.size());
+    std::transform(indexes.begin(), indexes.end(), gathered.begin(),
+                   [&values](std::size_t i) { return values[i]; });
+    values.swap(gathered);
+  };
+  gather(x);
+  gather(y);
+  gather(vx);
+  gather(vy);
+  gather(slot);
+}
+
+void fk::FlockState::assign(fk::FlockState const& other,
+                            std::vector<std::size_t> const& indexes) {
+  // Vectors are resized, so that their capacity is reused between calls
+  auto gather = [&indexes](auto& values, auto const& source) {
+    values.resize(indexes.size());
+    std::transform(indexes.begin(), indexes.end(), values.begin(),
+                   [&source](std::size_t i) { return source[i]; });
+  };
+  gather(x, other.x);
+  gather(y, other.y);
+  gather(vx, other.vx);
+  gather(vy, other.vy);
+  gather(slot, other.slot);
+}
+
+// Sorts a vector of boids in ascending order relative to x_position (and
+// y_position if x_positions are equal), used while generating flocks
+static void sort_boids(std::vector<bd::Boid>& boids) {
+  auto is_less = [](bd::Boid const& bd1, bd::Boid const& bd2) {
+    if (bd1.get_pos()[0] != bd2.get_pos()[0]) {
+      return bd1.get_pos()[0] < bd2.get_pos()[0];
+    } else if (bd1.get_pos()[1] != bd2.get_pos()[1]) {
+      return bd1.get_pos()[1] < bd2.get_pos()[1];
+    } else if (bd1.get_vel()[0] != bd2.get_vel()[0]) {
+      // Velocities break ties, so that the order is the same on every run
+      return bd1.get_vel()[0] < bd2.get_vel()[0];
+    } else {
+      return bd1.get_vel()[1] < bd2.get_vel()[1];
+    }
+  };
+  std::sort(std::execution::par, boids.begin(), boids.end(), is_less);
+}
+
+// Places n boids at least 0.3 * d_s apart and 0.6 * d_s away from the
+// obstacles, 20 away from the borders. The space is split in square cells,
+// the boids are put in n free cells chosen at random and moved by at most
+// half the margin between the cell size and 0.3 * d_s from their centres, so
+// that boids in different cells never get too close. Each free cell has its
+// own stream, so cells are checked and boids built in parallel
+static std::vector<bd::Boid> place_boids(int bd_n,
+                                         fk::Parameters const& params,
+                                         double view_ang,
+                                         mt::Vec2 const& space,
+                                         ob::ObstacleGrid const& obstacles) {
+  assert(bd_n >= 0);
+  auto const n = static_cast<std::size_t>(bd_n);
+  if (n == 0) return {};
+  double const min_dist = 0.3 * params.d_s;
+  double const width = space[0] - 40.;
+  double const height = space[1] - 40.;
+  assert(width >= min_dist && height >= min_dist);
+
+  // Cells start as large as possible and shrink until enough of them are
+  // free; if they can't, the flock doesn't fit in the space
+  double cell = std::max(min_dist, std::sqrt(width * height /
+                                             static_cast<double>(n)));
+  std::size_t cols{0};
+  auto centre = [&cell, &cols](std::size_t c) {
+    return mt::Vec2{20. + cell * (static_cast<double>(c % cols) + 0.5),
+                    20. + cell * (static_cast<double>(c / cols) + 0.5)};
+  };
+  std::vector<std::size_t> free_cells;
+  while (true) {
+    cols = static_cast<std::size_t>(width / cell);
+    auto rows = static_cast<std::size_t>(height / cell);
+    double clearance =
+        0.6 * params.d_s + std::sqrt(0.5) * (cell - min_dist);
+    std::vector<std::size_t> cells(cols * rows);
+    std::iota(cells.begin(), cells.end(), std::size_t{0});
+    free_cells.resize(cells.size());
+    auto last = std::copy_if(std::execution::par, cells.begin(), cells.end(),
+                             free_cells.begin(), [&](std::size_t c) {
+                               return !obstacles.overlaps(centre(c),
+                                                          clearance);
+                             });
+    free_cells.erase(last, free_cells.end());
+    if (free_cells.size() >= n || cell == min_dist) break;
+    cell = std::max(min_dist, 0.9 * cell);
+  }
+  if (free_cells.size() < n) {
+    throw std::runtime_error("Cannot place " + std::to_string(n) +
+                             " boids: at most " +
+                             std::to_string(free_cells.size()) +
+                             " fit in the space\n");
+  }
+
+  // The first output of the stream of each free cell is its key: the n cells
+  // with the lowest keys are taken
+  std::uint64_t const first = rn::reserve(free_cells.size());
+  std::vector<std::pair<std::uint32_t, std::size_t>> keys(free_cells.size());
+  std::vector<std::size_t> positions(free_cells.size());
+  std::iota(positions.begin(), positions.end(), std::size_t{0});
+  std::transform(std::execution::par, positions.begin(), positions.end(),
+                 keys.begin(), [first](std::size_t k) {
+                   return std::make_pair(rn::engine(first + k)(), k);
+                 });
+  std::nth_element(keys.begin(),
+                   keys.begin() + static_cast<std::ptrdiff_t>(n - 1),
+                   keys.end());
+
+  double const jitter = 0.5 * (cell - min_dist);
+  std::vector<bd::Boid> boids(n);
+  std::transform(
+      std::execution::par, keys.begin(),
+      keys.begin() + static_cast<std::ptrdiff_t>(n), boids.begin(),
+      [&](std::pair<std::uint32_t, std::size_t> const& key) {
+        auto rd = rn::engine(first + key.second);
+        rd();
+        std::uniform_real_distribution<> dist_jitter(-jitter, jitter);
+        std::uniform_real_distribution<> dist_vel(-150., 150.);
+        mt::Vec2 pos = centre(free_cells[key.second]);
+        pos += mt::Vec2{dist_jitter(rd), dist_jitter(rd)};
+        mt::Vec2 vel = {dist_vel(rd), dist_vel(rd)};
+        return bd::Boid{pos, vel, view_ang, space, params.d_s, params.s};
+      });
+  return boids;
+}
+
+// A cell is covered if its centre is closer than size + 0.6 * d_s to the
+// obstacle: those centres lie in a circle, widened by half a cell diagonal
+std::size_t fk::max_boids(double d_s, mt::Vec2 const& space, int n_obstacles,
+                          double max_size) {
+  assert(d_s > 0. && n_obstacles >= 0);
+  double const min_dist = 0.3 * d_s;
+  double const width = space[0] - 40.;
+  double const height = space[1] - 40.;
+  if (width < min_dist || height < min_dist) return 0;
+  double const cells = std::floor(width / min_dist) *
+                       std::floor(height / min_dist);
+  double const radius = max_size + 0.6 * d_s + std::sqrt(0.5) * min_dist;
+  double const covered = std::ceil(M_PI * radius * radius /
+                                   (min_dist * min_dist)) *
+                         n_obstacles;
+  return (cells > covered) ? static_cast<std::size_t>(cells - covered) : 0;
+}
+
 // Flock constructor with centre_of_mass... no more used in the simulation, but
 // used in many tests!
 fk::Flock::Flock(fk::Parameters const& params, int bd_n, bd::Boid const& com,
-                 double view_ang, std::valarray<double> const& space)
-    : f_flock{}, f_com{com}, f_params{params}, f_stats{} {
+                 double view_ang, mt::Vec2 const& space)
+    : f_state{},
+      f_com{com},
+      f_params{params},
+      f_stats{},
+      f_view_angle{view_ang},
+      f_cos_view{bd::view_cosine(view_ang)},
+      f_space{space} {
   // Generates randomly boids around centre of masss
   assert(bd_n >= 0);
 
@@ -48,7 +289,7 @@ fk::Flock::Flock(fk::Parameters const& params, int bd_n, bd::Boid const& com,
     (com.get_pos()[1] < space[1] / 2.)
         ? rg_y = com.get_pos()[1] - 20.
         : rg_y = space[1] - com.get_pos()[1] - 20.;
-    std::random_device rd;
+    auto rd = rn::engine();
     std::uniform_real_distribution<> dist_pos_x(com.get_pos()[0] - rg_x,
                                                 com.get_pos()[0] + rg_x + 0.1);
     std::uniform_real_distribution<> dist_vel_x(com.get_vel()[0] - 150.,
@@ -57,21 +298,23 @@ fk::Flock::Flock(fk::Parameters const& params, int bd_n, bd::Boid const& com,
                                                 com.get_pos()[1] + rg_y + 0.1);
     std::uniform_real_distribution<> dist_vel_y(com.get_vel()[1] - 150.,
                                                 com.get_vel()[1] + 150.1);
-    std::valarray<double> final_pos{0., 0.};
-    std::valarray<double> final_vel{0., 0.};
+    mt::Vec2 final_pos{0., 0.};
+    mt::Vec2 final_vel{0., 0.};
+    f_state.reserve(static_cast<std::size_t>(bd_n));
     for (auto n = 0; n < bd_n - 1; ++n) {
-      f_flock.push_back(bd::Boid{{dist_pos_x(rd), dist_pos_y(rd)},
-                                 {dist_vel_x(rd), dist_vel_y(rd)},
-                                 view_ang,
-                                 space,
-                                 params.d_s,
-                                 params.s});
-      final_pos += f_flock[static_cast<unsigned int>(n)].get_pos();
-      final_vel += f_flock[static_cast<unsigned int>(n)].get_vel();
+      bd::Boid boid{{dist_pos_x(rd), dist_pos_y(rd)},
+                    {dist_vel_x(rd), dist_vel_y(rd)},
+                    view_ang,
+                    space,
+                    params.d_s,
+                    params.s};
+      final_pos += boid.get_pos();
+      final_vel += boid.get_vel();
+      append(boid);
     }
-    f_flock.push_back(bd::Boid{bd_n * com.get_pos() - final_pos,
-                               bd_n * com.get_vel() - final_vel, view_ang,
-                               space, params.d_s, params.s});
+    append(bd::Boid{bd_n * com.get_pos() - final_pos,
+                    bd_n * com.get_vel() - final_vel, view_ang, space,
+                    params.d_s, params.s});
   }
 
   sort();
@@ -79,242 +322,257 @@ fk::Flock::Flock(fk::Parameters const& params, int bd_n, bd::Boid const& com,
 
 // Flock constructor without obstacles
 fk::Flock::Flock(fk::Parameters const& params, int bd_n, double view_ang,
-                 std::valarray<double> const& space)
-    : f_flock{}, f_params{params}, f_stats{} {
+                 mt::Vec2 const& space)
+    : f_state{},
+      f_params{params},
+      f_stats{},
+      f_view_angle{view_ang},
+      f_cos_view{bd::view_cosine(view_ang)},
+      f_space{space} {
   // Generates randomly boids in the simulation area (space)
   assert(bd_n >= 0);
-  std::random_device rd;
-  int x_max = static_cast<int>(2.5 * (space[0] - 40.) / params.d_s);
-  int y_max = static_cast<int>(2.5 * (space[1] - 40.) / params.d_s);
-
-  std::uniform_int_distribution<> dist_pos_x(0, x_max);
-  std::uniform_int_distribution<> dist_pos_y(0, y_max);
-
-  std::uniform_real_distribution<> dist_vel_x(-150., 150.);
-  std::uniform_real_distribution<> dist_vel_y(-150., 150.);
-
   f_com = bd::Boid{{0., 0.}, {0., 0.}, 0., space, params.d_s, params.s};
 
-  auto generator = [&]() -> bd::Boid {
-    std::valarray<double> pos = {
-        static_cast<double>(dist_pos_x(rd)) * 0.4 * (params.d_s) + 20.,
-        static_cast<double>(dist_pos_y(rd)) * 0.4 * (params.d_s) + 20.};
-    std::valarray<double> vel = {dist_vel_x(rd), dist_vel_y(rd)};
-    return bd::Boid{pos, vel, view_ang, space, params.d_s, params.s};
-  };
-
-  std::generate_n(std::execution::par, std::back_insert_iterator(f_flock), bd_n,
-                  generator);
+  // Boids are generated in a temporary vector, then moved in the flock
+  ob::ObstacleGrid no_obstacles;
+  no_obstacles.build({}, space);
+  auto boids = place_boids(bd_n, params, view_ang, space, no_obstacles);
+  sort_boids(boids);
 
-  sort();
-
-  auto compare_bd = [&](bd::Boid& b1, bd::Boid& b2) {
-    return bd::boid_dist(b1, b2) < 0.3 * params.d_s;
-  };
-
-  // Checks wheter or not there are overlapping boids
-  auto last = std::unique(std::execution::par, f_flock.begin(), f_flock.end(),
-                          compare_bd);
-  // f_flock.erase(last, f_flock.end());
-
-  // If there are, it regeneates them
-  while (last != f_flock.end()) {
-    std::generate(std::execution::par, last, f_flock.end(), generator);
-    sort();
-    last = std::unique(std::execution::par, f_flock.begin(), f_flock.end(),
-                       compare_bd);
-  }
+  f_state.reserve(boids.size());
+  for (auto const& boid : boids) append(boid);
 
   update_com();
 }
 
 // fk::Flock constructor with obstacles
 fk::Flock::Flock(fk::Parameters const& params, int bd_n, double view_ang,
-                 std::valarray<double> const& space,
-                 std::vector<ob::Obstacle> const& obs)
-    : f_flock{}, f_params{params}, f_stats{} {
+                 mt::Vec2 const& space, std::vector<ob::Obstacle> const& obs)
+    : f_state{},
+      f_params{params},
+      f_stats{},
+      f_view_angle{view_ang},
+      f_cos_view{bd::view_cosine(view_ang)},
+      f_space{space} {
   // Generates randomly boids in the suitable simulation area
   assert(bd_n > 0);
   f_com = bd::Boid{{0., 0.}, {0., 0.}, view_ang, space, params.d_s, params.s};
-  if (bd_n > 0) {
-    std::random_device rd;
-    int x_max = static_cast<int>(2.5 * (space[0] - 40.) / params.d_s);
-    int y_max = static_cast<int>(2.5 * (space[1] - 40.) / params.d_s);
 
-    std::uniform_int_distribution<> dist_pos_x(0, x_max);
-    std::uniform_int_distribution<> dist_pos_y(0, y_max);
-
-    std::uniform_real_distribution<> dist_vel_x(-150., 150.);
-    std::uniform_real_distribution<> dist_vel_y(-150., 150.);
+  // Boids are placed away from the obstacles, looked up in their grid
+  f_obs_grid.build(obs, space);
+  auto boids = place_boids(bd_n, params, view_ang, space, f_obs_grid);
+  sort_boids(boids);
 
-    auto generator = [&dist_pos_x, &dist_pos_y, &dist_vel_x, &dist_vel_y, &rd,
-                      &params, &space, &view_ang, &obs]() -> bd::Boid {
-      // Generates position
-      std::valarray<double> pos = {
-          static_cast<double>(dist_pos_x(rd)) * 0.4 * (params.d_s) + 20.,
-          static_cast<double>(dist_pos_y(rd)) * 0.4 * (params.d_s) + 20.};
-      // Checks wheter it overlaps or not with obstacles
-      auto overlap = [&pos, &params](ob::Obstacle const& obstacle) -> bool {
-        std::valarray<double> dist = pos - obstacle.get_pos();
-        return mt::vec_norm<double>(dist) <
-               obstacle.get_size() + 0.6 * params.d_s;
-      };
-
-      while (std::any_of(obs.begin(), obs.end(), overlap)) {
-        // As long as it overlaps with obstacles, it regenerates
-        pos = {static_cast<double>(dist_pos_x(rd)) * 0.4 * (params.d_s) + 20.,
-               static_cast<double>(dist_pos_y(rd)) * 0.4 * (params.d_s) + 20.};
-      }
-
-      // If it doesn't overlap, it returns a boidd with random position and
-      // speed
-      std::valarray<double> vel = {dist_vel_x(rd), dist_vel_y(rd)};
-      return bd::Boid{pos, vel, view_ang, space, params.d_s, params.s};
-    };
-
-    // Generates flock
-    std::generate_n(std::execution::par, std::back_insert_iterator(f_flock),
-                    bd_n, generator);
-
-    // It sorts it
-    sort();
-
-    // Checks wheter two boids overlap
-    auto compare_bd = [&](bd::Boid& b1, bd::Boid& b2) {
-      return b1.get_pos()[0] == b2.get_pos()[0] &&
-             b1.get_pos()[1] == b2.get_pos()[1];
-    };
-
-    auto last = std::unique(std::execution::par, f_flock.begin(), f_flock.end(),
-                            compare_bd);
-
-    // Until there are overlapping boids, it regenerates checking they don't
-    // overlap with obstacless
-    while (last != f_flock.end()) {
-      std::generate(std::execution::par, last, f_flock.end(), generator);
-      sort();
-      last = std::unique(std::execution::par, f_flock.begin(), f_flock.end(),
-                         compare_bd);
-    }
-    sort();
-    update_com();
-  } else {
-  }
+  // Moves the boids in the flock storage
+  f_state.reserve(boids.size());
+  for (auto const& boid : boids) append(boid);
+  update_com();
 }
 
 // Add_boid in a random position without obstacles
-void fk::Flock::add_boid() {
-  std::random_device rd;
-  int x_max =
-      static_cast<int>(2.5 * (f_com.get_space()[0] - 40.) / f_params.d_s);
-  int y_max =
-      static_cast<int>(2.5 * (f_com.get_space()[1] - 40.) / f_params.d_s);
+void fk::Flock::add_boid() { insert_boids(1, nullptr); }
 
-  // Distributions of ints!! Positons are discretized. Two boids either
-  // coincide, or do not coincide
-  std::uniform_int_distribution<> dist_pos_x(0, x_max);
-  std::uniform_int_distribution<> dist_pos_y(0, y_max);
+// Add_boid in a random position considering obstacles
+void fk::Flock::add_boid(std::vector<ob::Obstacle> const& obstacles) {
+  add_boids(1, obstacles);
+}
 
-  std::uniform_real_distribution<> dist_vel_x(-150., 150.);
-  std::uniform_real_distribution<> dist_vel_y(-150., 150.);
+void fk::Flock::add_boids(int count) { insert_boids(count, nullptr); }
 
-  std::valarray<double> pos = {
-      static_cast<double>(dist_pos_x(rd)) * 0.4 * (f_params.d_s) + 20.,
-      static_cast<double>(dist_pos_y(rd)) * 0.4 * (f_params.d_s) + 20.};
+void fk::Flock::add_boids(int count,
+                          std::vector<ob::Obstacle> const& obstacles) {
+  f_obs_grid.update(obstacles, f_space);
+  insert_boids(count, &f_obs_grid);
+}
 
-  // Checks wheter a boid coincide with another
+// Candidates are drawn in parallel, each from its own stream, on the same
+// lattice used by the constructors: they are discarded if they coincide with
+// a boid, looked up in the grid, or with another candidate, or if they
+// overlap an obstacle. Valid ones are sorted and merged with the flock, which
+// is already sorted
+void fk::Flock::insert_boids(int count, ob::ObstacleGrid const* obstacles) {
+  assert(count >= 0);
+  if (count == 0) return;
+  auto const n = static_cast<std::size_t>(count);
+  // The merge below needs the flock sorted, which erase and push_back don't
+  // keep: sort is cheap when it is already almost sorted
+  sort();
+  int x_max = static_cast<int>(2.5 * (f_space[0] - 40.) / f_params.d_s);
+  int y_max = static_cast<int>(2.5 * (f_space[1] - 40.) / f_params.d_s);
 
-  auto find_clone = [&pos](bd::Boid& b1) {
-    return b1.get_pos()[0] == pos[0] && b1.get_pos()[1] == pos[1];
+  // Distributions of ints!! Positons are discretized. Two boids either
+  // coincide, or do not coincide
+  auto candidate = [&](std::uint64_t stream) {
+    auto rd = rn::engine(stream);
+    std::uniform_int_distribution<> dist_pos_x(0, x_max);
+    std::uniform_int_distribution<> dist_pos_y(0, y_max);
+    std::uniform_real_distribution<> dist_vel_x(-150., 150.);
+    std::uniform_real_distribution<> dist_vel_y(-150., 150.);
+    mt::Vec2 pos = {
+        static_cast<double>(dist_pos_x(rd)) * 0.4 * (f_params.d_s) + 20.,
+        static_cast<double>(dist_pos_y(rd)) * 0.4 * (f_params.d_s) + 20.};
+    mt::Vec2 vel = {dist_vel_x(rd), dist_vel_y(rd)};
+    return bd::Boid{pos, vel, f_view_angle, f_space, f_params.d_s,
+                    f_params.s};
+  };
+  auto const& cells = grid();
+  auto invalid = [&](bd::Boid const& boid) {
+    double x = boid.get_pos()[0];
+    double y = boid.get_pos()[1];
+    bool clone{false};
+    cells.for_each_near(x, y, [&](std::size_t j) {
+      clone = clone || (f_state.x[j] == x && f_state.y[j] == y);
+    });
+    return clone ||
+           (obstacles != nullptr && obstacles->overlaps(boid.get_pos(),
+                                                        0.6 * f_params.d_s));
+  };
+  auto same_pos = [](bd::Boid const& b1, bd::Boid const& b2) {
+    return b1.get_pos() == b2.get_pos();
   };
 
-  // Until there are no coinciding boids, it regenerates positions
-  while (std::any_of(std::execution::par, f_flock.begin(), f_flock.end(),
-                     find_clone)) {
-    pos = {static_cast<double>(dist_pos_x(rd)) * 0.4 * (f_params.d_s) + 20.,
-           static_cast<double>(dist_pos_y(rd)) * 0.4 * (f_params.d_s) + 20.};
+  // Until there are enough valid candidates, it draws the missing ones
+  std::vector<bd::Boid> boids;
+  std::vector<bd::Boid> drawn;
+  std::vector<std::uint64_t> streams;
+  while (boids.size() < n) {
+    std::size_t missing = n - boids.size();
+    streams.resize(missing);
+    std::iota(streams.begin(), streams.end(), rn::reserve(missing));
+    drawn.resize(missing);
+    std::transform(std::execution::par, streams.begin(), streams.end(),
+                   drawn.begin(), candidate);
+    auto last = std::remove_if(std::execution::par, drawn.begin(),
+                               drawn.end(), invalid);
+    boids.insert(boids.end(), drawn.begin(), last);
+    sort_boids(boids);
+    boids.erase(std::unique(boids.begin(), boids.end(), same_pos),
+                boids.end());
   }
-
-  // It generates its speed and adds it to the flock
-  std::valarray<double> vel = {dist_vel_x(rd), dist_vel_y(rd)};
-  f_flock.push_back(bd::Boid{pos, vel, f_flock[0].get_view_angle(),
-                             f_flock[0].get_space(), f_params.d_s, f_params.s});
-  sort();
+  boids.resize(n);
+
+  // The new boids are appended, then both sorted ranges are merged
+  std::size_t const first_new = f_state.size();
+  for (auto const& boid : boids) append(boid);
+  f_order.resize(f_state.size());
+  auto is_less = [this](std::size_t i1, std::size_t i2) {
+    if (f_state.x[i1] != f_state.x[i2]) {
+      return f_state.x[i1] < f_state.x[i2];
+    } else {
+      return f_state.y[i1] < f_state.y[i2];
+    }
+  };
+  auto const& positions = indexes();
+  std::merge(positions.begin(),
+             positions.begin() + static_cast<std::ptrdiff_t>(first_new),
+             positions.begin() + static_cast<std::ptrdiff_t>(first_new),
+             positions.end(), f_order.begin(), is_less);
+  reorder(f_order);
+  // The centre of mass kept in f_com is not updated by push_back and erase
   update_com();
 }
 
-// Add_boid in a random position considering obstacles
-void fk::Flock::add_boid(std::vector<ob::Obstacle> const& obstacles) {
-  std::random_device rd;
-  int x_max =
-      static_cast<int>(2.5 * (f_com.get_space()[0] - 40.) / f_params.d_s);
-  int y_max =
-      static_cast<int>(2.5 * (f_com.get_space()[1] - 40.) / f_params.d_s);
-
-  // Distributions of ints!! Positons are discretized. Two boids either
-  // coincide, or do not coincide
-  std::uniform_int_distribution<> dist_pos_x(0, x_max);
-  std::uniform_int_distribution<> dist_pos_y(0, y_max);
+// Builds the i-th boid of a flock state
+bd::Boid fk::Flock::make_boid(fk::FlockState const& state,
+                              std::size_t i) const {
+  assert(i < state.size());
+  bd::Boid boid{{0., 0.}, {0., 0.}, f_view_angle,
+                f_space,  f_params.d_s, f_params.s};
+  boid.set_state(state.x[i], state.y[i], state.vx[i], state.vy[i]);
+  return boid;
+}
 
-  std::uniform_real_distribution<> dist_vel_x(-150., 150.);
-  std::uniform_real_distribution<> dist_vel_y(-150., 150.);
+// Rebuilds, if needed, the vector of boids used by the iterators
+std::vector<bd::Boid> const& fk::Flock::view() const {
+  if (!f_view_valid) {
+    f_view.clear();
+    f_view.reserve(f_state.size());
+    for (std::size_t i = 0; i < f_state.size(); ++i) {
+      f_view.push_back(make_boid(f_state, i));
+    }
+    f_view_valid = true;
+  }
+  return f_view;
+}
 
-  std::valarray<double> pos = {
-      static_cast<double>(dist_pos_x(rd)) * 0.4 * (f_params.d_s) + 20.,
-      static_cast<double>(dist_pos_y(rd)) * 0.4 * (f_params.d_s) + 20.};
+// Rebuilds, if needed, the grid of the boid positions. Not thread-safe: it
+// has to be called before any parallel use of the grid
+gr::Grid const& fk::Flock::grid() const {
+  if (!f_grid_valid) {
+    f_grid.build(f_params.d, f_space, f_state.x, f_state.y);
+    f_cells.assign(f_state, f_grid.get_items());
+    f_grid_valid = true;
+  }
+  return f_grid;
+}
 
-  // Checks wheter a boid coincide with another or it overlaps with an obstacle
+// Marks the boid copies and the grid as outdated after a change of f_state
+void fk::Flock::invalidate() {
+  f_view_valid = false;
+  f_grid_valid = false;
+}
 
-  auto find_clone = [&pos](bd::Boid& b1) {
-    return b1.get_pos()[0] == pos[0] && b1.get_pos()[1] == pos[1];
-  };
-  auto overlap = [&pos, this](ob::Obstacle const& obstacle) -> bool {
-    std::valarray<double> dist = pos - obstacle.get_pos();
-    return mt::vec_norm<double>(dist) <
-           obstacle.get_size() + 0.6 * f_params.d_s;
-  };
+// Returns 0, 1, ..., size() - 1: only the positions added since the last call
+// are filled
+std::vector<std::size_t> const& fk::Flock::indexes() {
+  std::size_t const filled = f_indexes.size();
+  f_indexes.resize(f_state.size());
+  if (f_indexes.size() > filled) {
+    std::iota(f_indexes.begin() + static_cast<std::ptrdiff_t>(filled),
+              f_indexes.end(), filled);
+  }
+  return f_indexes;
+}
 
-  // Until boid coincide with another one or overlaps with obstacle, it
-  // regenerates
-  while (std::any_of(std::execution::par, f_flock.begin(), f_flock.end(),
-                     find_clone) ||
-         std::any_of(obstacles.begin(), obstacles.end(), overlap)) {
-    pos = {static_cast<double>(dist_pos_x(rd)) * 0.4 * (f_params.d_s) + 20.,
-           static_cast<double>(dist_pos_y(rd)) * 0.4 * (f_params.d_s) + 20.};
+void fk::Flock::reorder(std::vector<std::size_t> const& order) {
+  f_back.assign(f_state, order);
+  f_state.swap(f_back);
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    if (order[i] != i) f_position[f_state.slot[i]] = i;
   }
+  invalidate();
+}
 
-  // It generates its speed and adds it to the flock
-  std::valarray<double> vel = {dist_vel_x(rd), dist_vel_y(rd)};
-  f_flock.push_back(bd::Boid{pos, vel, f_flock[0].get_view_angle(),
-                             f_flock[0].get_space(), f_params.d_s, f_params.s});
-  sort();
-  update_com();
+// Position in the flock of the boid pointed by an iterator
+std::size_t fk::Flock::index(
+    std::vector<bd::Boid>::const_iterator it) const {
+  assert(f_view_valid && it >= f_view.begin() && it <= f_view.end());
+  return static_cast<std::size_t>(it - f_view.begin());
 }
 
-std::vector<bd::Boid>::iterator fk::Flock::begin() { return f_flock.begin(); }
-std::vector<bd::Boid>::iterator fk::Flock::end() { return f_flock.end(); }
+std::vector<bd::Boid>::const_iterator fk::Flock::begin() const {
+  return view().begin();
+}
+std::vector<bd::Boid>::const_iterator fk::Flock::end() const {
+  return view().end();
+}
 
-int fk::Flock::size() const { return static_cast<int>(f_flock.size()); }
+int fk::Flock::size() const { return static_cast<int>(f_state.size()); }
 
 // Add a boid in a flock, used in tests
 void fk::Flock::push_back(bd::Boid const& boid) {
   assert(boid.get_par_ds() == f_params.d_s);
   assert(boid.get_par_s() == f_params.s);
-  f_flock.push_back(boid);
+  append(boid);
+  invalidate();
 }
 
 // Used in tests
-std::vector<bd::Boid> const& fk::Flock::get_flock() const { return f_flock; }
+std::vector<bd::Boid> const& fk::Flock::get_flock() const { return view(); }
 
-bd::Boid const& fk::Flock::get_boid(int n) const {
-  assert(n >= 1 && static_cast<unsigned int>(n) <= f_flock.size());
-  return f_flock[static_cast<unsigned int>(n) - 1];
+fk::FlockState const& fk::Flock::get_state() const { return f_state; }
+
+bd::Boid fk::Flock::get_boid(int n) const {
+  assert(n >= 1 && static_cast<unsigned int>(n) <= f_state.size());
+  return make_boid(f_state, static_cast<std::size_t>(n) - 1);
 }
 
 bd::Boid const& fk::Flock::get_com() const { return f_com; }
 
 fk::Parameters const& fk::Flock::get_params() const { return f_params; }
 
+double fk::Flock::get_view_angle() const { return f_view_angle; }
+
 void fk::Flock::set_parameter(int index, double value) {
   assert(index >= 0 && index < 5);
   switch (index) {
@@ -323,15 +581,11 @@ void fk::Flock::set_parameter(int index, double value) {
       break;
     case 1:
       f_params.d_s = value;
-      for (auto it_s = f_flock.begin(); it_s != f_flock.end(); ++it_s) {
-        it_s->set_par_ds(value);
-      }
+      f_com.set_par_ds(value);
       break;
     case 2:
       f_params.s = value;
-      for (auto it_s = f_flock.begin(); it_s != f_flock.end(); ++it_s) {
-        it_s->set_par_s(value);
-      }
+      f_com.set_par_s(value);
       break;
     case 3:
       f_params.a = value;
@@ -342,40 +596,143 @@ void fk::Flock::set_parameter(int index, double value) {
     default:
       break;
   }
+  invalidate();
 }
 
 void fk::Flock::set_space(double sx, double sy) {
   assert(sx > 0. && sy > 0.);
   f_com.set_space(sx, sy);
-  for (auto& bd : f_flock) {
-    bd.set_space(sx, sy);
+  f_space = {sx, sy};
+  invalidate();
+}
+
+void fk::Flock::erase(std::vector<bd::Boid>::const_iterator it) {
+  auto i = index(it);
+  release_slot(f_state.slot[i]);
+  std::size_t const last = f_state.size() - 1;
+  if (i != last) {
+    f_state.x[i] = f_state.x[last];
+    f_state.y[i] = f_state.y[last];
+    f_state.vx[i] = f_state.vx[last];
+    f_state.vy[i] = f_state.vy[last];
+    f_state.slot[i] = f_state.slot[last];
+    f_position[f_state.slot[i]] = i;
   }
+  f_state.resize(last);
+  invalidate();
 }
 
-void fk::Flock::erase(std::vector<bd::Boid>::iterator it) { f_flock.erase(it); }
+std::size_t fk::Flock::acquire_slot() {
+  if (f_free_slots.empty()) {
+    assert(f_alive.size() < (std::size_t{1} << id_slot_bits));
+    f_alive.push_back(1);
+    f_generation.push_back(0);
+    f_position.push_back(0);
+    return f_alive.size() - 1;
+  }
+  std::size_t s = f_free_slots.back();
+  f_free_slots.pop_back();
+  f_alive[s] = 1;
+  return s;
+}
+
+void fk::Flock::release_slot(std::size_t s) {
+  assert(s < f_alive.size() && f_alive[s]);
+  f_alive[s] = 0;
+  ++f_generation[s];
+  f_free_slots.push_back(s);
+}
+
+void fk::Flock::append(bd::Boid const& boid) {
+  std::size_t s = acquire_slot();
+  f_position[s] = f_state.size();
+  f_state.push_back(boid, s);
+}
+
+void fk::Flock::keep(std::vector<std::size_t> const& alive) {
+  if (alive.size() == f_state.size()) return;
+  // Positions missing from alive are the dead boids
+  std::size_t next{0};
+  for (std::size_t i = 0; i < f_state.size(); ++i) {
+    if (next < alive.size() && alive[next] == i) {
+      ++next;
+    } else {
+      release_slot(f_state.slot[i]);
+    }
+  }
+  reorder(alive);
+}
+
+std::size_t fk::Flock::get_slot(std::size_t i) const {
+  assert(i < f_state.size());
+  return f_state.slot[i];
+}
+
+bool fk::Flock::is_alive(std::size_t s) const {
+  return s < f_alive.size() && f_alive[s];
+}
+
+std::size_t fk::Flock::get_slots() const { return f_alive.size(); }
+
+fk::Id fk::Flock::get_id(std::size_t i) const {
+  std::size_t s = get_slot(i);
+  return static_cast<Id>((f_generation[s] << id_slot_bits) | s);
+}
+
+std::size_t fk::Flock::index_of(Id id) const {
+  std::size_t s = id & ((Id{1} << id_slot_bits) - 1);
+  if (!is_alive(s) || ((f_generation[s] ^ (id >> id_slot_bits)) & 0xFF) != 0) {
+    return f_state.size();
+  }
+  return f_position[s];
+}
 
 void fk::Flock::update_com() {
-  f_com.get_vel() = {0., 0.};
-  f_com.get_pos() = {0., 0.};
-  for (auto bd : f_flock) {
-    f_com.get_vel() += bd.get_vel();
-    f_com.get_pos() += bd.get_pos();
+  double com_x{0.};
+  double com_y{0.};
+  double com_vx{0.};
+  double com_vy{0.};
+  for (std::size_t i = 0; i < f_state.size(); ++i) {
+    com_x += f_state.x[i];
+    com_y += f_state.y[i];
+    com_vx += f_state.vx[i];
+    com_vy += f_state.vy[i];
   }
-  f_com.get_vel() /= static_cast<double>(f_flock.size());
-  f_com.get_pos() /= static_cast<double>(f_flock.size());
+  auto n = static_cast<double>(f_state.size());
+  f_com.get_pos() = {com_x / n, com_y / n};
+  f_com.get_vel() = {com_vx / n, com_vy / n};
 }
 
+// Neighbours are returned from the nearest to the farthest
 std::vector<bd::Boid> fk::Flock::get_neighbours(
-    std::vector<bd::Boid>::iterator it) const {
-  return get_vector_neighbours(f_flock, it, f_params.d);
+    std::vector<bd::Boid>::const_iterator it) const {
+  auto i = index(it);
+  std::vector<std::size_t> indexes;
+  if (i < f_state.size()) {
+    grid();
+    for_each_neighbour(f_state, i,
+                       [&indexes](std::size_t j) { indexes.push_back(j); });
+  }
+  auto dist2 = [this, i](std::size_t j) {
+    double dx = f_state.x[j] - f_state.x[i];
+    double dy = f_state.y[j] - f_state.y[i];
+    return dx * dx + dy * dy;
+  };
+  std::stable_sort(indexes.begin(), indexes.end(),
+                   [&dist2](std::size_t j1, std::size_t j2) {
+                     return dist2(j1) < dist2(j2);
+                   });
+
+  std::vector<bd::Boid> neighbours;
+  for (auto j : indexes) neighbours.push_back(make_boid(f_state, j));
+  return neighbours;
 }
 
 // Avoid_pred for tests
-std::valarray<double> fk::Flock::avoid_pred(bd::Boid const& bd,
-                                            pr::Predator const& pred,
-                                            double boid_pred_detection,
-                                            double boid_pred_repulsion) const {
-  std::valarray<double> delta_vel = {0., 0.};
+mt::Vec2 fk::Flock::avoid_pred(bd::Boid const& bd, pr::Predator const& pred,
+                               double boid_pred_detection,
+                               double boid_pred_repulsion) const {
+  mt::Vec2 delta_vel = {0., 0.};
   // Determines wheter to apply or not separation from predator
   (bd::boid_dist(pred, bd) < boid_pred_detection * f_params.d)
       ? delta_vel -=
@@ -384,9 +741,9 @@ std::valarray<double> fk::Flock::avoid_pred(bd::Boid const& bd,
   return delta_vel;
 }
 
-std::valarray<double> fk::Flock::avoid_pred(bd::Boid const& bd,
-                                            pr::Predator const& pred) const {
-  std::valarray<double> delta_vel = {0., 0.};
+mt::Vec2 fk::Flock::avoid_pred(bd::Boid const& bd,
+                               pr::Predator const& pred) const {
+  mt::Vec2 delta_vel = {0., 0.};
   // Determines wheter to apply or not separation from predator
   (bd::boid_dist(pred, bd) < 1.2 * f_params.d)
       ? delta_vel -= 0.3 * f_params.s * (pred.get_pos() - bd.get_pos())
@@ -394,179 +751,197 @@ std::valarray<double> fk::Flock::avoid_pred(bd::Boid const& bd,
   return delta_vel;
 }
 
-// vel correction without obstacles (used in tests)
-std::valarray<double> fk::Flock::vel_correction(
-    std::vector<bd::Boid>::iterator it) {
-  assert(it >= f_flock.begin() && it < f_flock.end());
-  // Find its neighbours
-  auto neighbours = get_neighbours(it);
-  std::valarray<double> delta_vel = {0., 0.};
-  if (neighbours.size() > 0) {
-    auto n_minus = neighbours.size();
-    std::valarray<double> local_com = {0., 0.};
-    // For each boid in neighbours it applies separation is it's in range d_s,
-    // and alignmnet
-    for (bd::Boid bd : neighbours) {
-      // Separation
-      (bd::boid_dist(bd, *it) < f_params.d_s)
-          ? delta_vel -= f_params.s * (bd.get_pos() - it->get_pos())
-          : delta_vel;
-      // Alignment
-      delta_vel += f_params.a * (bd.get_vel() - it->get_vel()) /
-                   static_cast<double>(n_minus);
-
-      local_com += bd.get_pos();
-    }
+// Query of the flocking kernel for the i-th boid of a flock state
+kn::Query fk::Flock::query(fk::FlockState const& state, std::size_t i) const {
+  return kn::make_query(state.x[i], state.y[i], state.vx[i], state.vy[i],
+                        f_cos_view, f_params.d, f_params.d_s);
+}
 
-    // Calculates local centre of mass and apllies cohesion
-    delta_vel +=
-        f_params.c * (local_com / static_cast<double>(n_minus) - it->get_pos());
+// vel correction of the i-th boid of a flock state: used in update state.
+// The kernel sums the contributions of the boids in the cells around it, which
+// are contiguous in f_cells
+mt::Vec2 fk::Flock::vel_correction(fk::FlockState const& state,
+                                   std::size_t i) const {
+  assert(i < state.size() && f_grid_valid);
+  kn::Query const q = query(state, i);
+  kn::Candidates const candidates{f_cells.x.data(), f_cells.y.data(),
+                                  f_cells.vx.data(), f_cells.vy.data()};
+  kn::Sums sums;
+  f_grid.for_each_near_range(
+      q.x, q.y, [&q, &candidates, &sums](std::size_t begin, std::size_t end) {
+        kn::accumulate(q, candidates, begin, end, sums);
+      });
+
+  // Separation from the boids in range d_s, alignment and cohesion towards
+  // the local centre of mass
+  mt::Vec2 delta_vel = {0., 0.};
+  if (sums.count > 0.) {
+    delta_vel[0] = -f_params.s * sums.sep_x +
+                   f_params.a * sums.dvx / sums.count +
+                   f_params.c * sums.dx / sums.count;
+    delta_vel[1] = -f_params.s * sums.sep_y +
+                   f_params.a * sums.dvy / sums.count +
+                   f_params.c * sums.dy / sums.count;
   }
   return delta_vel;
 }
 
-// vel correction without predators and copy_flock: used in update state
-std::valarray<double> fk::Flock::vel_correction(
-    std::vector<bd::Boid> const& copy_flock,
-    std::vector<bd::Boid>::iterator it) {
-  assert(it >= copy_flock.begin() && it < copy_flock.end() &&
-         copy_flock.size() == f_flock.size());
-  // Find its neighbours
-  auto neighbours = get_vector_neighbours(copy_flock, it, f_params.d);
-  std::valarray<double> delta_vel = {0., 0.};
-
-  // For each boid in neighbours it applies separation is it's in range d_s,
-  // and alignmnet
-  if (neighbours.size() > 0) {
-    auto n_minus = neighbours.size();
-    std::valarray<double> local_com = {0., 0.};
-    for (bd::Boid bd : neighbours) {
-      // Separation
-      (bd::boid_dist(bd, *it) < f_params.d_s)
-          ? delta_vel -= f_params.s * (bd.get_pos() - it->get_pos())
-          : delta_vel;
-      // Alignment
-      delta_vel += f_params.a * (bd.get_vel() - it->get_vel()) /
-                   static_cast<double>(n_minus);
-
-      local_com += bd.get_pos();
-    }
-    // Calculates local centre of mass and apllies cohesion
-    delta_vel +=
-        f_params.c * (local_com / static_cast<double>(n_minus) - it->get_pos());
-  }
-  return delta_vel;
+// vel correction without obstacles (used in tests)
+mt::Vec2 fk::Flock::vel_correction(
+    std::vector<bd::Boid>::const_iterator it) {
+  grid();
+  return vel_correction(f_state, index(it));
 }
 
 // Overload di vel_correction with more predators used in tests
-std::valarray<double> fk::Flock::vel_correction(
-    std::vector<bd::Boid>::iterator it, std::vector<pr::Predator> const& preds,
-    double boid_pred_detection, double boid_pred_repulsion) {
-  assert(it >= f_flock.begin() && it < f_flock.end());
+mt::Vec2 fk::Flock::vel_correction(
+    std::vector<bd::Boid>::const_iterator it,
+    std::vector<pr::Predator> const& preds, double boid_pred_detection,
+    double boid_pred_repulsion) {
+  auto i = index(it);
+  assert(i < f_state.size());
 
-  auto neighbours = get_neighbours(it);
-  std::valarray<double> delta_vel = {0., 0.};
+  mt::Vec2 delta_vel = {0., 0.};
+  bd::Boid boid = make_boid(f_state, i);
 
   // Checks separation from predators if needed
-  for (pr::Predator pt : preds) {
-    (bd::boid_dist(pt, *it) < boid_pred_detection * f_params.d)
-        ? delta_vel -=
-          boid_pred_repulsion * f_params.s * (pt.get_pos() - it->get_pos())
-        : delta_vel;
+  for (auto const& pt : preds) {
+    delta_vel +=
+        avoid_pred(boid, pt, boid_pred_detection, boid_pred_repulsion);
   }
 
   // Checks separation from neighbours if needed
-  if (neighbours.size() > 0) {
-    auto n_minus = neighbours.size();
-    std::valarray<double> local_com = {0., 0.};
-    for (bd::Boid bd : neighbours) {
-      // Separation
-      (bd::boid_dist(bd, *it) < f_params.d_s)
-          ? delta_vel -= f_params.s * (bd.get_pos() - it->get_pos())
-          : delta_vel;
-      // Alignment
-      delta_vel += f_params.a * (bd.get_vel() - it->get_vel()) /
-                   static_cast<double>(n_minus);
-
-      local_com += bd.get_pos();
-    }
-    // Cohesion
-    delta_vel +=
-        f_params.c * (local_com / static_cast<double>(n_minus) - it->get_pos());
-  }
+  grid();
+  delta_vel += vel_correction(f_state, i);
   return delta_vel;
 }
 
-void fk::Flock::update_global_state(double delta_t, bool brd_bhv,
-                                    std::vector<pr::Predator>& preds,
-                                    std::vector<ob::Obstacle> const& obs) {
-  // It creates a vector of pairs of boids and ints that stores preys. The int
-  // states for the predator whose preys it is.
-  std::vector<std::pair<bd::Boid, int>> preys;
+void fk::Flock::index_predators(std::vector<pr::Predator> const& preds,
+                                double reach) {
+  // Cells must cover predation, avoidance and the range of every predator
+  double cell = std::max(reach, 0.3 * f_params.d_s);
+  f_pred_x.resize(preds.size());
+  f_pred_y.resize(preds.size());
+  for (std::size_t p = 0; p < preds.size(); ++p) {
+    f_pred_x[p] = preds[p].get_pos()[0];
+    f_pred_y[p] = preds[p].get_pos()[1];
+    cell = std::max(cell, preds[p].get_range());
+  }
+  f_pred_grid.build(cell, f_space, f_pred_x, f_pred_y);
+}
 
-  std::mutex mtx;
+void fk::Flock::remove_eaten(std::vector<pr::Predator> const& preds) {
+  if (preds.empty()) return;
 
   // Finds victims of predators
-  auto bd_eaten = [this, &preds](bd::Boid const& bd) {
+  double const d_s = f_params.d_s;
+  auto bd_eaten = [this, &preds, d_s](std::size_t i) {
     // valuta se è mangiato da (almeno) un predatore
-    auto above = [this, &bd](pr::Predator const& pred) -> bool {
-      return bd::boid_dist(pred, bd) < 0.3 * f_params.d_s;
-    };
-    return std::any_of(preds.begin(), preds.end(), above);
+    bool eaten{false};
+    f_pred_grid.for_each_near(
+        f_state.x[i], f_state.y[i], [&](std::size_t p) {
+          double dx = preds[p].get_pos()[0] - f_state.x[i];
+          double dy = preds[p].get_pos()[1] - f_state.y[i];
+          eaten = eaten || std::sqrt(dx * dx + dy * dy) < 0.3 * d_s;
+        });
+    return eaten;
   };
 
-  // Removes victims
-  auto last = std::remove_if(std::execution::par, f_flock.begin(),
-                             f_flock.end(), bd_eaten);
-  f_flock.erase(last, f_flock.end());
-
-  //  Duplicates f_flock in copy_flock to keep track of states before updating
-  //  it
-  std::vector<bd::Boid> copy_flock = f_flock;
+  // The survivors are copied from the indexes, in order, into a buffer that
+  // keeps its memory between steps
+  auto const& positions = indexes();
+  f_survivors.resize(positions.size());
+  auto last = std::remove_copy_if(std::execution::par, positions.begin(),
+                                  positions.end(), f_survivors.begin(),
+                                  bd_eaten);
+  f_survivors.erase(last, f_survivors.end());
+  keep(f_survivors);
+}
 
-  // It initialises a vector of ints, that enables us to parallelize the update
-  std::vector<int> indexes;
+void fk::Flock::update_global_state(double delta_t, bool brd_bhv,
+                                    std::vector<pr::Predator>& preds,
+                                    std::vector<ob::Obstacle> const& obs) {
+  TR_SPAN("update_global_state");
+  // Removes victims
+  {
+    TR_SPAN("remove eaten");
+    index_predators(preds, 1.2 * f_params.d);
+    remove_eaten(preds);
+  }
 
-  for (int i = 0; static_cast<unsigned int>(i) < f_flock.size(); ++i) {
-    indexes.push_back(i);
+  // States before updating are read from f_state, new ones are written in
+  // f_back. The grid is built here, since the parallel update only reads it
+  {
+    TR_SPAN("back buffer");
+    f_back.resize(f_state.size());
+  }
+  bool const use_field = f_field_cell > 0.;
+  {
+    TR_SPAN("neighbour search");
+    grid();
+    f_obs_grid.update(obs, f_space);
+    if (use_field) field();
   }
 
   // lambda used to update global state
-  auto boid_update = [&mtx, &preds, &preys, this, delta_t, brd_bhv, &copy_flock,
-                      &obs](int const& index, bd::Boid const& bd) -> bd::Boid {
+  auto boid_update = [&preds, this, delta_t, brd_bhv, use_field](
+                        std::size_t index,
+                        std::vector<std::pair<std::size_t, int>>& preys) {
+    bd::Boid bd = make_boid(f_state, index);
     // aggiorna lo stato del boid con o senza percezione predatore
-    std::valarray<double> corr = {0., 0.};
-    // For each boid, it calculates it vel_correction to avoid predators and
-    // check wheter it's a prey or not. In case, its pushed back in the preys
-    // vector, together with an int indicated whose predator it's a prey
-    for (int idx = 0; static_cast<long unsigned int>(idx) < preds.size();
-         ++idx) {
-      corr += avoid_pred(bd, preds[static_cast<unsigned int>(idx)]);
-      if (is_visible(bd, preds[static_cast<unsigned int>(idx)]) &&
-          bd::boid_dist(preds[static_cast<unsigned int>(idx)], bd) <
-              preds[static_cast<unsigned int>(idx)].get_range()) {
-        // blocca il mutex prima della modifica di preys
-        std::lock_guard<std::mutex> lck(mtx);
-        preys.push_back({bd, idx});
-      }
-    }
+    mt::Vec2 corr = {0., 0.};
+    // For each predator near the boid, it calculates its vel_correction to
+    // avoid it and checks whether the boid is its prey. In case, it's pushed
+    // back in the preys vector, together with the index of the predator
+    f_pred_grid.for_each_near(bd.get_pos()[0], bd.get_pos()[1],
+                              [&](std::size_t p) {
+                                corr += avoid_pred(bd, preds[p]);
+                                if (is_visible(bd, preds[p]) &&
+                                    bd::boid_dist(preds[p], bd) <
+                                        preds[p].get_range()) {
+                                  preys.push_back(
+                                      {index, static_cast<int>(p)});
+                                }
+                              });
 
     // Updates the boid state
-    f_flock[static_cast<unsigned int>(index)].update_state(
-        delta_t,
-        vel_correction(copy_flock, copy_flock.begin() + index) +
-            bd.avoid_obs(obs) + corr,
-        brd_bhv);
-    return f_flock[static_cast<long unsigned int>(index)];
+    if (use_field) {
+      mt::Vec2 delta_vel =
+          vel_correction(f_state, index) + bd.avoid_obs(f_field) + corr;
+      bd.update_state(delta_t, delta_vel, brd_bhv, f_field);
+    } else {
+      mt::Vec2 delta_vel =
+          vel_correction(f_state, index) + bd.avoid_obs(f_obs_grid) + corr;
+      bd.update_state(delta_t, delta_vel, brd_bhv);
+    }
+    f_back.set(index, bd);
   };
 
-  // For each boid (from index.begin() == 1 to index.end() == end) updates its
-  // state using lambda boid_update
-  std::transform(std::execution::par, indexes.begin(), indexes.end(),
-                 copy_flock.begin(), f_flock.begin(), boid_update);
+  // For each boid updates its state using lambda boid_update
+  {
+    TR_SPAN("integration");
+    update_in_blocks(boid_update);
+    // Boids keep their order, so the slots stay in f_state
+    f_state.swap_motion(f_back);
+    invalidate();
+  }
 
-  update_com();
-  sort();
+  // It creates a vector of pairs of boids and ints that stores preys. The int
+  // states for the predator whose preys it is. Preys are taken before the
+  // update, which is now in f_back
+  std::vector<std::pair<bd::Boid, int>> preys;
+  {
+    TR_SPAN("prey aggregation");
+    preys = merge_preys(f_back);
+  }
+  {
+    TR_SPAN("com");
+    reduce_totals();
+  }
+  {
+    TR_SPAN("sort");
+    sort();
+  }
 
   // Using the vector of preys, it updates the state of all predators
   update_predators_state(preds, delta_t, brd_bhv, preys, obs);
@@ -581,59 +956,70 @@ void fk::Flock::update_global_state(
     double border_repulsion, double boid_pred_detection,
     double boid_pred_repulsion, double boid_obs_detection,
     double boid_obs_repulsion, double pred_pred_repulsion) {
-  // boid su cui applica caccia = prede
-  std::vector<std::pair<bd::Boid, int>> preys;
-
-  std::mutex mtx;
-
-  auto bd_eaten = [this, &preds](bd::Boid const& bd) {
-    auto above = [this, &bd](pr::Predator const& pred) -> bool {
-      return bd::boid_dist(pred, bd) < 0.3 * f_params.d_s;
-    };
-    return std::any_of(preds.begin(), preds.end(), above);
-  };
+  TR_SPAN("update_global_state");
+  {
+    TR_SPAN("remove eaten");
+    index_predators(preds, boid_pred_detection * f_params.d);
+    remove_eaten(preds);
+  }
+  {
+    TR_SPAN("back buffer");
+    f_back.resize(f_state.size());
+  }
+  {
+    TR_SPAN("neighbour search");
+    grid();
+    f_obs_grid.update(obs, f_space);
+  }
 
-  auto last = std::remove_if(std::execution::par, f_flock.begin(),
-                             f_flock.end(), bd_eaten);
-  f_flock.erase(last, f_flock.end());
-
-  std::vector<bd::Boid> copy_flock = f_flock;
-
-  std::vector<int> indexes;
-
-  for (int i = 0; static_cast<unsigned int>(i) < f_flock.size(); ++i) {
-    indexes.push_back(i);
-  }
-
-  auto boid_update = [&mtx, &preds, &preys, this, delta_t, brd_bhv, &copy_flock,
-                      &obs, border_detection, border_repulsion,
-                      boid_pred_detection, boid_pred_repulsion,
-                      boid_obs_detection, boid_obs_repulsion](
-                         int const& index, bd::Boid const& bd) -> bd::Boid {
-    std::valarray<double> corr = {0., 0.};
-    for (int idx = 0; static_cast<unsigned int>(idx) < preds.size(); ++idx) {
-      corr += avoid_pred(bd, preds[static_cast<unsigned int>(idx)],
-                         boid_pred_detection, boid_pred_repulsion);
-      if (is_visible(bd, preds[static_cast<unsigned int>(idx)]) &&
-          bd::boid_dist(preds[static_cast<unsigned int>(idx)], bd) <
-              preds[static_cast<unsigned int>(idx)].get_range()) {
-        std::lock_guard<std::mutex> lck(mtx);
-        preys.push_back({bd, idx});
-      }
-    }
-    f_flock[static_cast<unsigned int>(index)].update_state(
-        delta_t,
-        vel_correction(copy_flock, copy_flock.begin() + index) +
-            bd.avoid_obs(obs, boid_obs_detection, boid_obs_repulsion) + corr,
-        brd_bhv, border_detection, border_repulsion);
-    return f_flock[static_cast<long unsigned int>(index)];
+  auto boid_update = [&preds, this, delta_t, brd_bhv, border_detection,
+                      border_repulsion, boid_pred_detection,
+                      boid_pred_repulsion, boid_obs_detection,
+                      boid_obs_repulsion](
+                        std::size_t index,
+                        std::vector<std::pair<std::size_t, int>>& preys) {
+    bd::Boid bd = make_boid(f_state, index);
+    mt::Vec2 corr = {0., 0.};
+    f_pred_grid.for_each_near(
+        bd.get_pos()[0], bd.get_pos()[1], [&](std::size_t p) {
+          corr += avoid_pred(bd, preds[p], boid_pred_detection,
+                             boid_pred_repulsion);
+          if (is_visible(bd, preds[p]) &&
+              bd::boid_dist(preds[p], bd) < preds[p].get_range()) {
+            preys.push_back({index, static_cast<int>(p)});
+          }
+        });
+    mt::Vec2 delta_vel =
+        vel_correction(f_state, index) +
+        bd.avoid_obs(f_obs_grid, boid_obs_detection, boid_obs_repulsion) +
+        corr;
+    bd.update_state(delta_t, delta_vel, brd_bhv, border_detection,
+                    border_repulsion);
+    f_back.set(index, bd);
   };
 
-  std::transform(std::execution::par, indexes.begin(), indexes.end(),
-                 copy_flock.begin(), f_flock.begin(), boid_update);
+  {
+    TR_SPAN("integration");
+    update_in_blocks(boid_update);
+    // Boids keep their order, so the slots stay in f_state
+    f_state.swap_motion(f_back);
+    invalidate();
+  }
 
-  update_com();
-  sort();
+  // boid su cui applica caccia = prede
+  std::vector<std::pair<bd::Boid, int>> preys;
+  {
+    TR_SPAN("prey aggregation");
+    preys = merge_preys(f_back);
+  }
+  {
+    TR_SPAN("com");
+    reduce_totals();
+  }
+  {
+    TR_SPAN("sort");
+    sort();
+  }
 
   update_predators_state(preds, delta_t, brd_bhv, preys, obs,
                          pred_pred_repulsion, boid_obs_detection,
@@ -641,78 +1027,158 @@ void fk::Flock::update_global_state(
                          border_repulsion);
 }
 
-void fk::Flock::sort() {
+std::vector<std::pair<bd::Boid, int>> fk::Flock::merge_preys(
+    fk::FlockState const& state) const {
+  std::size_t total{0};
+  for (auto const& block : f_prey_blocks) total += block.size();
+
+  std::vector<std::pair<bd::Boid, int>> preys;
+  preys.reserve(total);
+  for (auto const& block : f_prey_blocks) {
+    for (auto const& prey : block) {
+      preys.push_back({make_boid(state, prey.first), prey.second});
+    }
+  }
+  return preys;
+}
+
+std::size_t fk::Flock::sort() {
   // Sorts boids in the flock in ascending order relative to x_position.
-  // If two boids have the same x_position, it considers y_position
+  // If two boids have the same x_position, it considers y_position.
+  // The positions are sorted first, then every array is reordered.
+  // Boids move little in a step, so the flock is almost sorted and an
+  // incremental sort is used
 
-  auto is_less = [](bd::Boid const& bd1, bd::Boid const& bd2) {
-    if (bd1.get_pos()[0] != bd2.get_pos()[0]) {
-      return bd1.get_pos()[0] < bd2.get_pos()[0];
+  f_order.resize(f_state.size());
+  std::iota(f_order.begin(), f_order.end(), std::size_t{0});
+
+  auto is_less = [this](std::size_t i1, std::size_t i2) {
+    if (f_state.x[i1] != f_state.x[i2]) {
+      return f_state.x[i1] < f_state.x[i2];
     } else {
-      return bd1.get_pos()[1] < bd2.get_pos()[1];
+      return f_state.y[i1] < f_state.y[i2];
     }
   };
 
-  std::sort(std::execution::par, f_flock.begin(), f_flock.end(), is_less);
+  mt::incremental_sort(f_order.begin(), f_order.end(), is_less,
+                       4 * f_order.size() + 64);
+
+  f_sort_moves = 0;
+  for (std::size_t i = 0; i < f_order.size(); ++i) {
+    (f_order[i] != i) ? ++f_sort_moves : f_sort_moves;
+  }
+  if (f_sort_moves > 0) reorder(f_order);
+  return f_sort_moves;
 }
 
-void fk::Flock::update_stats() {
-  if (this->size() <= 1) {
+std::size_t fk::Flock::get_sort_moves() const { return f_sort_moves; }
+
+void fk::Flock::set_field_cell(double cell) {
+  assert(cell >= 0.);
+  f_field_cell = cell;
+  f_field = df::Field{};
+}
+
+double fk::Flock::get_field_cell() const { return f_field_cell; }
+
+// Rebuilds, if the obstacles changed, the distance field. Its reach covers the
+// detection ranges of obstacles and borders
+df::Field const& fk::Flock::field() {
+  assert(f_field_cell > 0.);
+  if (f_field.empty() || f_field_version != f_obs_grid.get_version()) {
+    f_field.build(f_obs_grid, f_space, f_field_cell,
+                  9. * f_params.d_s + 20.);
+    f_field_version = f_obs_grid.get_version();
+  }
+  return f_field;
+}
+
+void fk::Flock::Totals::add(Totals const& other) {
+  x += other.x;
+  y += other.y;
+  vx += other.vx;
+  vy += other.vy;
+  vel += other.vel;
+  vel2 += other.vel2;
+  dist += other.dist;
+  dist2 += other.dist2;
+  couples += other.couples;
+}
+
+// For the i-th boid, it checks the boids in the cells around it. If the
+// distance between them is less than d, it considers it as a neighbour and
+// adds the distance. Each couple is counted once, from the boid with the
+// lower index
+void fk::Flock::add_stats(std::size_t i, Totals& totals) const {
+  assert(i < f_state.size() && f_grid_valid);
+  auto const& x = f_state.x;
+  auto const& y = f_state.y;
+  double vel = std::sqrt(f_state.vx[i] * f_state.vx[i] +
+                         f_state.vy[i] * f_state.vy[i]);
+  totals.vel += vel;
+  totals.vel2 += vel * vel;
+
+  f_grid.for_each_near(x[i], y[i], [&](std::size_t j) {
+    if (j <= i) return;
+    double dist = std::sqrt((x[i] - x[j]) * (x[i] - x[j]) +
+                            (y[i] - y[j]) * (y[i] - y[j]));
+    if (dist <= f_params.d && dist > 0) {
+      totals.dist += dist;
+      totals.dist2 += dist * dist;
+      ++totals.couples;
+    }
+  });
+}
+
+// Statistics of n boids from their totals
+void fk::Flock::set_stats(Totals const& totals, std::size_t n) {
+  if (n <= 1) {
     f_stats.av_dist = 0.;
     f_stats.dist_RMS = 0.;
     f_stats.av_vel = 0.;
     f_stats.vel_RMS = 0.;
+    return;
+  }
+  double mean_vel = totals.vel / static_cast<double>(n);
+  double square_mean_vel = totals.vel2 / static_cast<double>(n);
+  f_stats.av_vel = mean_vel;
+  f_stats.vel_RMS = sqrt(square_mean_vel - mean_vel * mean_vel);
+
+  // If no couples are founded, average distance and its RMS are 0
+  if (totals.couples == 0) {
+    f_stats.av_dist = 0.;
+    f_stats.dist_RMS = 0.;
   } else {
-    double mean_dist{0};
-    double square_mean_dist{0};
-    double mean_vel{0};
-    double square_mean_vel{0};
-    int number_of_couples{0};
-
-    // For each boid, it checks all other boids. If the distance between them is
-    // less than d, it considers it as a neighbour and adds the distance to the
-    // average_distance. Variable number_couples takes count of, as the name
-    // says, the number of couples counted
-
-    for (auto it = f_flock.begin(); it < f_flock.end(); ++it) {
-      mean_vel += mt::vec_norm<double>(it->get_vel());
-      square_mean_vel += (mt::vec_norm<double>(it->get_vel()) *
-                          mt::vec_norm<double>(it->get_vel()));
-
-      for (auto ut = it;
-           ut < f_flock.end() &&
-           std::abs(it->get_pos()[0] - ut->get_pos()[0]) < f_params.d;
-           ++ut) {
-        if (bd::boid_dist(*it, *ut) <= f_params.d &&
-            bd::boid_dist(*it, *ut) > 0) {
-          mean_dist += bd::boid_dist(*it, *ut);
-          square_mean_dist +=
-              (bd::boid_dist(*it, *ut) * bd::boid_dist(*it, *ut));
-          ++number_of_couples;
-        }
-      }
-    }
+    double mean_dist = totals.dist / static_cast<double>(totals.couples);
+    double square_mean_dist =
+        totals.dist2 / static_cast<double>(totals.couples);
+    f_stats.av_dist = mean_dist;
+    f_stats.dist_RMS = sqrt(square_mean_dist - mean_dist * mean_dist);
+  }
+}
 
-    mean_vel /= static_cast<double>(this->size());
-    square_mean_vel /= static_cast<double>(this->size());
-    double vel_RMS = sqrt(square_mean_vel - mean_vel * mean_vel);
+// Called after the swap: the totals of the new state give the centre of mass,
+// the statistics refer to the previous one, now in f_back
+void fk::Flock::reduce_totals() {
+  Totals totals;
+  for (auto const& block : f_total_blocks) totals.add(block);
+  auto n = static_cast<double>(f_state.size());
+  f_com.get_pos() = {totals.x / n, totals.y / n};
+  f_com.get_vel() = {totals.vx / n, totals.vy / n};
+  if (f_stats_in_update) set_stats(totals, f_back.size());
+}
 
-    f_stats.av_vel = mean_vel;
-    f_stats.vel_RMS = vel_RMS;
+void fk::Flock::set_stats_in_update(bool stats_in_update) {
+  f_stats_in_update = stats_in_update;
+}
 
-    // If no couples are founded, average distance and its RMS are 0
-    if (number_of_couples == 0) {
-      f_stats.av_dist = 0.;
-      f_stats.dist_RMS = 0.;
-    } else {
-      mean_dist /= static_cast<double>(number_of_couples);
-      square_mean_dist /= static_cast<double>(number_of_couples);
-      double dist_RMS = sqrt(square_mean_dist - mean_dist * mean_dist);
+bool fk::Flock::get_stats_in_update() const { return f_stats_in_update; }
 
-      f_stats.av_dist = mean_dist;
-      f_stats.dist_RMS = dist_RMS;
-    }
-  }
+void fk::Flock::update_stats() {
+  Totals totals;
+  grid();
+  for (std::size_t i = 0; i < f_state.size(); ++i) add_stats(i, totals);
+  set_stats(totals, f_state.size());
 }
 
-fk::Statistics const& fk::Flock::get_stats() const { return f_stats; }
\ No newline at end of file
+fk::Statistics const& fk::Flock::get_stats() const { return f_stats; }
@@ -1,10 +1,17 @@
 #ifndef FLOCK_HPP
 #define FLOCK_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <utility>
 #include <vector>
 
 #include "boid.hpp"
+#include "grid.hpp"
+#include "kernel.hpp"
 #include "predator.hpp"
+#include "trace.hpp"
 
 namespace fk {
 
@@ -19,6 +26,12 @@ struct Statistics {
   Statistics(double, double, double, double);
 };
 
+// Identifier of a boid: its slot in the lower 24 bits and, in the upper 8,
+// how many times the slot was released before, so that a boid born in the
+// slot of a dead one gets a different identifier
+using Id = std::uint32_t;
+constexpr std::size_t id_slot_bits = 24;
+
 struct Parameters {
   double d;
   double d_s;
@@ -29,51 +42,246 @@ struct Parameters {
   Parameters(double, double, double, double, double);
 };
 
+// Structure-of-arrays storage of the flock: the i-th element of each vector
+// refers to the i-th boid of the flock. Quantities shared by all boids (view
+// angle, space, d_s, s) are stored once in the Flock. Boids are moved around
+// by sorting, while slot is the index of a boid which doesn't change while
+// it's alive
+struct FlockState {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> vx;
+  std::vector<double> vy;
+  std::vector<std::size_t> slot;
+
+  std::size_t size() const;
+  // Angle of the i-th velocity, computed only when needed by rendering
+  double get_angle(std::size_t) const;
+  void reserve(std::size_t);
+  void clear();
+  // Resizes every array, keeping their capacity
+  void resize(std::size_t);
+  void swap(FlockState&);
+  // Swaps positions and velocities only, each state keeps its slots
+  void swap_motion(FlockState&);
+  // Without a slot, the boid takes its position as slot
+  void push_back(bd::Boid const&);
+  void push_back(bd::Boid const&, std::size_t);
+  // Sets position and velocity, the slot is kept
+  void set(std::size_t, bd::Boid const&);
+  void erase(std::size_t);
+  // It moves the boid in position indexes[i] to position i, dropping the
+  // boids not listed
+  void permute(std::vector<std::size_t> const&);
+  // It copies in position i the boid in position indexes[i] of another state
+  void assign(FlockState const&, std::vector<std::size_t> const&);
+};
+
 class Flock {
-  std::vector<bd::Boid> f_flock;
+  FlockState f_state;
   bd::Boid f_com;
   Parameters f_params;
   Statistics f_stats;
+  double f_view_angle{0.};
+  double f_cos_view{1.};
+  mt::Vec2 f_space;
+  std::size_t f_sort_moves{0};
+
+  // Back buffer of f_state: a step reads f_state and writes f_back, then the
+  // two are swapped. f_indexes holds 0, 1, ..., size() - 1 for the parallel
+  // loops and f_order is the scratch vector of sort; all of them keep their
+  // memory between steps
+  FlockState f_back;
+  std::vector<std::size_t> f_indexes;
+  std::vector<std::size_t> f_order;
+  // Positions of the boids not eaten in a step
+  std::vector<std::size_t> f_survivors;
+
+  // Slots in use and released ones, reused before new slots are taken. For
+  // each slot, f_generation counts its releases and f_position is the
+  // position in f_state of its boid, updated whenever boids are moved
+  std::vector<char> f_alive;
+  std::vector<std::size_t> f_free_slots;
+  std::vector<std::uint32_t> f_generation;
+  std::vector<std::size_t> f_position;
+
+  // Preys found by each block of the parallel update, as pairs of boid
+  // position and predator index
+  std::vector<std::vector<std::pair<std::size_t, int>>> f_prey_blocks;
+
+  // Sums over a set of boids: positions and velocities for the centre of
+  // mass, speeds and distances of the couples of neighbours for the
+  // statistics
+  struct Totals {
+    double x{0.};
+    double y{0.};
+    double vx{0.};
+    double vy{0.};
+    double vel{0.};
+    double vel2{0.};
+    double dist{0.};
+    double dist2{0.};
+    int couples{0};
+    void add(Totals const&);
+  };
+  // Totals of each block of the parallel update. The statistics are summed
+  // there only if f_stats_in_update is set
+  std::vector<Totals> f_total_blocks;
+  bool f_stats_in_update{false};
+
+  // Boids built from f_state, returned by the iterator-based interface
+  mutable std::vector<bd::Boid> f_view;
+  mutable bool f_view_valid{false};
+
+  // Cell list of f_state positions, with cells of side (at least) d, and
+  // copy of f_state sorted by cell, read by the flocking kernel
+  mutable gr::Grid f_grid;
+  mutable FlockState f_cells;
+  mutable bool f_grid_valid{false};
+
+  // Cell list of the predator positions, rebuilt at each step with cells as
+  // large as the widest predator-boid interaction
+  gr::Grid f_pred_grid;
+  std::vector<double> f_pred_x;
+  std::vector<double> f_pred_y;
+
+  // Broadphase over the obstacles, rebuilt when they change
+  ob::ObstacleGrid f_obs_grid;
+
+  // Distance field used for obstacles and borders when f_field_cell is
+  // positive, rebuilt only when the obstacles change
+  double f_field_cell{0.};
+  df::Field f_field;
+  std::size_t f_field_version{0};
+  df::Field const& field();
+
+  bd::Boid make_boid(FlockState const&, std::size_t) const;
+  std::vector<bd::Boid> const& view() const;
+  gr::Grid const& grid() const;
+  kn::Query query(FlockState const&, std::size_t) const;
+  void invalidate();
+  std::vector<std::size_t> const& indexes();
+  // Keeps the boids listed in the vector, in its order, through f_back
+  void reorder(std::vector<std::size_t> const&);
+  std::size_t index(std::vector<bd::Boid>::const_iterator) const;
+  std::size_t acquire_slot();
+  void release_slot(std::size_t);
+  // Adds a boid with a new slot
+  void append(bd::Boid const&);
+  // Keeps the boids listed in the vector, in ascending order, releasing the
+  // slots of the others
+  void keep(std::vector<std::size_t> const&);
+  // Adds boids avoiding the obstacles of a grid, if given
+  void insert_boids(int, ob::ObstacleGrid const*);
+  // Builds f_pred_grid; takes the predators and the reach of their
+  // interactions with the boids other than predation
+  void index_predators(std::vector<pr::Predator> const&, double);
+  // Removes the boids eaten by any predator, found through f_pred_grid
+  void remove_eaten(std::vector<pr::Predator> const&);
+
+  // Calls f(j) for each neighbour j of the i-th boid of a state, looking only
+  // in the grid cells around it. The state must have the same positions as
+  // f_state, and the grid must be already built
+  template <typename F>
+  void for_each_neighbour(FlockState const& state, std::size_t i,
+                          F&& f) const {
+    assert(i < state.size() && f_grid_valid);
+    kn::Query const q = query(state, i);
+    f_grid.for_each_near(state.x[i], state.y[i], [&](std::size_t j) {
+      if (kn::is_neighbour(q, state.x[j] - q.x, state.y[j] - q.y)) f(j);
+    });
+  }
+  mt::Vec2 vel_correction(FlockState const&, std::size_t) const;
+  // Adds the speed of the i-th boid of f_state and its distances from the
+  // neighbours with a greater index. The grid must be already built
+  void add_stats(std::size_t, Totals&) const;
+
+  // Calls update(i, preys) for each boid i, in parallel over blocks of
+  // consecutive boids. preys is the buffer of the block, so that no lock is
+  // needed to fill it. Each block also sums the new states written in f_back
+  // and, if required, the statistics of f_state
+  template <typename F>
+  void update_in_blocks(F&& update) {
+    std::size_t const block = 64;
+    std::size_t const n = f_state.size();
+    std::size_t const blocks = (n + block - 1) / block;
+    f_prey_blocks.resize(blocks);
+    f_total_blocks.resize(blocks);
+    auto const& positions = indexes();
+    std::for_each(std::execution::par, positions.begin(),
+                  positions.begin() + static_cast<std::ptrdiff_t>(blocks),
+                  [&](std::size_t b) {
+                    TR_SPAN("integration block");
+                    auto& preys = f_prey_blocks[b];
+                    auto& totals = f_total_blocks[b];
+                    preys.clear();
+                    totals = Totals{};
+                    for (std::size_t i = b * block;
+                         i < std::min(n, (b + 1) * block); ++i) {
+                      update(i, preys);
+                      totals.x += f_back.x[i];
+                      totals.y += f_back.y[i];
+                      totals.vx += f_back.vx[i];
+                      totals.vy += f_back.vy[i];
+                      if (f_stats_in_update) add_stats(i, totals);
+                    }
+                  });
+  }
+  // Sums the totals of the blocks in block order: sets the centre of mass
+  // and, if required, the statistics
+  void reduce_totals();
+  void set_stats(Totals const&, std::size_t);
+  // Merges the buffers in block order, so that the result does not depend on
+  // scheduling, building the preys from a state
+  std::vector<std::pair<bd::Boid, int>> merge_preys(FlockState const&) const;
 
  public:
-  Flock(Parameters const&, int, bd::Boid const&, double,
-        std::valarray<double> const&);
-  Flock(Parameters const&, int, double, std::valarray<double> const&);
-  Flock(Parameters const&, int, double, std::valarray<double> const&,
+  Flock(Parameters const&, int, bd::Boid const&, double, mt::Vec2 const&);
+  // Boids in random positions: throws std::runtime_error if they don't fit
+  // in the space at the minimum distance
+  Flock(Parameters const&, int, double, mt::Vec2 const&);
+  Flock(Parameters const&, int, double, mt::Vec2 const&,
         std::vector<ob::Obstacle> const&);
   Flock() = default;
   void add_boid();
   void add_boid(std::vector<ob::Obstacle> const&);
+  // Adds boids in random positions, all at once: the flock is merged with
+  // the sorted new boids and the centre of mass is recomputed
+  void add_boids(int);
+  void add_boids(int, std::vector<ob::Obstacle> const&);
   int size() const;
   void push_back(bd::Boid const& boid);
-  std::vector<bd::Boid>::iterator begin();
-  std::vector<bd::Boid>::iterator end();
+  // Read-only iterators over a copy of the flock, rebuilt after each change
+  std::vector<bd::Boid>::const_iterator begin() const;
+  std::vector<bd::Boid>::const_iterator end() const;
 
   std::vector<bd::Boid> const& get_flock() const;
-  bd::Boid const& get_boid(int) const;
+  FlockState const& get_state() const;
+  bd::Boid get_boid(int) const;
   bd::Boid const& get_com() const;
   Parameters const& get_params() const;
+  double get_view_angle() const;
   void set_parameter(int, double);
   void set_space(double, double);
-  void erase(std::vector<bd::Boid>::iterator);
+  // Removes a boid in O(1), moving the last one in its place: the order is
+  // restored by the next sort
+  void erase(std::vector<bd::Boid>::const_iterator);
   void update_com();
 
-  std::vector<bd::Boid> get_neighbours(std::vector<bd::Boid>::iterator) const;
+  std::vector<bd::Boid> get_neighbours(
+      std::vector<bd::Boid>::const_iterator) const;
 
   // Avoid_pred for tests
-  std::valarray<double> avoid_pred(bd::Boid const&, pr::Predator const&, double,
-                                   double) const;
-  std::valarray<double> avoid_pred(bd::Boid const&, pr::Predator const&) const;
+  mt::Vec2 avoid_pred(bd::Boid const&, pr::Predator const&, double,
+                      double) const;
+  mt::Vec2 avoid_pred(bd::Boid const&, pr::Predator const&) const;
 
   // Vel_correction for tests
-  std::valarray<double> vel_correction(std::vector<bd::Boid>::iterator);
-  std::valarray<double> vel_correction(std::vector<bd::Boid>::iterator it,
-                                       std::vector<pr::Predator> const& preds,
-                                       double boid_pred_detection,
-                                       double boid_pred_repulsion);
-  // per aggiornare lo stato:
-  std::valarray<double> vel_correction(std::vector<bd::Boid> const&,
-                                       std::vector<bd::Boid>::iterator);
+  mt::Vec2 vel_correction(std::vector<bd::Boid>::const_iterator);
+  mt::Vec2 vel_correction(std::vector<bd::Boid>::const_iterator it,
+                          std::vector<pr::Predator> const& preds,
+                          double boid_pred_detection,
+                          double boid_pred_repulsion);
 
   // update_global_state for tests
   // Parameters in order: border_detection, border_repulsion,
@@ -90,11 +298,37 @@ class Flock {
   void update_global_state(double, bool, std::vector<pr::Predator>&,
                            std::vector<ob::Obstacle> const&);
 
-  void sort();
+  // Sorts the flock, returning the number of boids that changed position
+  std::size_t sort();
 
+  // Lattice spacing of the distance field used by update_global_state for
+  // obstacles and borders; 0 (default) checks them directly
+  void set_field_cell(double);
+  double get_field_cell() const;
+  // Slot of the i-th boid, and whether a slot holds a boid. Slots go from 0
+  // to get_slots() - 1, so they can index per-boid data kept elsewhere
+  std::size_t get_slot(std::size_t) const;
+  bool is_alive(std::size_t) const;
+  std::size_t get_slots() const;
+  // Identifier of the i-th boid, and position of the boid with an identifier
+  // (size() if it is not alive)
+  Id get_id(std::size_t) const;
+  std::size_t index_of(Id) const;
+  // Number of boids moved by the last sort
+  std::size_t get_sort_moves() const;
+
+  // If set, update_global_state also computes the statistics of the state it
+  // starts from, in the same parallel pass
+  void set_stats_in_update(bool);
+  bool get_stats_in_update() const;
   void update_stats();
   Statistics const& get_stats() const;
 };
+
+// Number of boids that always fit in a space with a number of obstacles of
+// at most the given size, when placed by the random constructors: lattice
+// cells at the minimum distance, less those each obstacle may cover
+std::size_t max_boids(double, mt::Vec2 const&, int, double);
 }  // namespace fk
 
-#endif
\ No newline at end of file
+#endif
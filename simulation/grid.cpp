@@ -0,0 +1,73 @@
+#include "grid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+gr::Grid::Grid()
+    : g_cell{1.},
+      g_cols{1},
+      g_rows{1},
+      g_start(2, 0),
+      g_items{},
+      g_cells{} {}
+
+void gr::Grid::build(double min_cell, mt::Vec2 const& space,
+                     std::vector<double> const& x,
+                     std::vector<double> const& y) {
+  assert(min_cell >= 0. && space[0] > 0. &&
+         space[1] > 0. && x.size() == y.size());
+  // Cells are never smaller than min_cell. For sparse sets of points they are
+  // enlarged, so that the number of cells stays proportional to the number of
+  // points
+  double max_cells = 4. * static_cast<double>(x.size()) + 64.;
+  g_cell = std::max(min_cell, std::sqrt(space[0] * space[1] / max_cells));
+  g_cols = static_cast<std::size_t>(std::ceil(space[0] / g_cell));
+  g_rows = static_cast<std::size_t>(std::ceil(space[1] / g_cell));
+  (g_cols == 0) ? g_cols = 1 : g_cols;
+  (g_rows == 0) ? g_rows = 1 : g_rows;
+
+  // Counting sort: it counts the points in each cell, computes the starting
+  // position of each cell and then places the points
+  g_start.assign(g_cols * g_rows + 1, 0);
+  g_cells.resize(x.size());
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    g_cells[i] = row(y[i]) * g_cols + col(x[i]);
+    ++g_start[g_cells[i] + 1];
+  }
+  for (std::size_t c = 1; c < g_start.size(); ++c) {
+    g_start[c] += g_start[c - 1];
+  }
+  g_items.resize(x.size());
+  std::vector<std::size_t> next(g_start.begin(), g_start.end() - 1);
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    g_items[next[g_cells[i]]++] = i;
+  }
+}
+
+double gr::Grid::get_cell_size() const { return g_cell; }
+
+std::size_t gr::Grid::get_cols() const { return g_cols; }
+
+std::size_t gr::Grid::get_rows() const { return g_rows; }
+
+std::vector<std::size_t> const& gr::Grid::get_items() const {
+  return g_items;
+}
+
+std::size_t gr::Grid::col(double x) const {
+  if (!(x > 0.)) return 0;
+  auto c = static_cast<std::size_t>(x / g_cell);
+  return (c < g_cols) ? c : g_cols - 1;
+}
+
+std::size_t gr::Grid::row(double y) const {
+  if (!(y > 0.)) return 0;
+  auto r = static_cast<std::size_t>(y / g_cell);
+  return (r < g_rows) ? r : g_rows - 1;
+}
+
+std::size_t gr::Grid::count(std::size_t c_x, std::size_t c_y) const {
+  assert(c_x < g_cols && c_y < g_rows);
+  return g_start[c_y * g_cols + c_x + 1] - g_start[c_y * g_cols + c_x];
+}
@@ -0,0 +1,72 @@
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "math.hpp"
+
+namespace gr {
+// Uniform grid (cell list) over the simulation space. Points are bucketed in
+// square cells whose side is at least the interaction distance, so that all
+// the points within that distance from a given one lie in the 3x3 block of
+// cells around it
+class Grid {
+  double g_cell;
+  std::size_t g_cols;
+  std::size_t g_rows;
+  // g_start[c] is the position in g_items of the first point in cell c
+  std::vector<std::size_t> g_start;
+  std::vector<std::size_t> g_items;
+  std::vector<std::size_t> g_cells;
+
+ public:
+  Grid();
+
+  // Rebuilds the grid with a counting sort of the points into the cells.
+  // Takes: minimum cell size, space, x and y positions of the points
+  void build(double, mt::Vec2 const&, std::vector<double> const&,
+             std::vector<double> const&);
+
+  double get_cell_size() const;
+  std::size_t get_cols() const;
+  std::size_t get_rows() const;
+  // Column and row of a position; points outside the space are assigned to
+  // the border cells
+  std::size_t col(double) const;
+  std::size_t row(double) const;
+
+  // Number of points in the cell (col, row)
+  std::size_t count(std::size_t, std::size_t) const;
+
+  // Indexes of the points, sorted by cell
+  std::vector<std::size_t> const& get_items() const;
+
+  // Calls f(begin, end) for each range of positions in get_items() covering
+  // the 3x3 block of cells around (x, y): cells of a row are contiguous, so
+  // there is one range per row
+  template <typename F>
+  void for_each_near_range(double x, double y, F&& f) const {
+    if (g_items.empty()) return;
+    std::size_t c_x = col(x);
+    std::size_t c_y = row(y);
+    std::size_t first_col = (c_x > 0) ? c_x - 1 : 0;
+    std::size_t last_col = (c_x + 1 < g_cols) ? c_x + 1 : c_x;
+    std::size_t first_row = (c_y > 0) ? c_y - 1 : 0;
+    std::size_t last_row = (c_y + 1 < g_rows) ? c_y + 1 : c_y;
+    for (std::size_t r = first_row; r <= last_row; ++r) {
+      f(g_start[r * g_cols + first_col], g_start[r * g_cols + last_col + 1]);
+    }
+  }
+
+  // Calls f(index) for each point in the 3x3 block of cells around (x, y)
+  template <typename F>
+  void for_each_near(double x, double y, F&& f) const {
+    for_each_near_range(x, y, [this, &f](std::size_t begin, std::size_t end) {
+      for (std::size_t k = begin; k < end; ++k) f(g_items[k]);
+    });
+  }
+};
+}  // namespace gr
+
+#endif
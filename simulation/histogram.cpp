@@ -0,0 +1,127 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+// Longest duration that can be recorded, in microseconds
+constexpr std::uint64_t max_us = (std::uint64_t{1} << 32) - 1;
+
+std::size_t highest_bit(std::uint64_t value) {
+  std::size_t bit = 0;
+  while (value >>= 1) ++bit;
+  return bit;
+}
+}  // namespace
+
+// Durations below sub_count us have a bucket each; above, the bucket is
+// given by the highest bit and by the sub_bits bits after it
+std::size_t hs::Histogram::bucket(std::uint64_t us) {
+  us = std::min(us, max_us);
+  if (us < sub_count) return static_cast<std::size_t>(us);
+  std::size_t shift = highest_bit(us) - sub_bits;
+  return (shift + 1) * sub_count + static_cast<std::size_t>(us >> shift) -
+         sub_count;
+}
+
+std::uint64_t hs::Histogram::lowest(std::size_t b) {
+  assert(b < bucket_count);
+  if (b < sub_count) return b;
+  std::size_t shift = b / sub_count - 1;
+  return static_cast<std::uint64_t>(b % sub_count + sub_count) << shift;
+}
+
+std::uint64_t hs::Histogram::width(std::size_t b) {
+  assert(b < bucket_count);
+  return (b < sub_count) ? 1 : std::uint64_t{1} << (b / sub_count - 1);
+}
+
+void hs::Histogram::record(double ms) {
+  assert(ms >= 0.);
+  double us = std::min(std::round(ms * 1000.), static_cast<double>(max_us));
+  auto value = static_cast<std::uint64_t>(us);
+  ++h_counts[bucket(value)];
+  ++h_total;
+  h_max = std::max(h_max, value);
+  h_sum += ms;
+}
+
+void hs::Histogram::remove(double ms) {
+  assert(ms >= 0.);
+  double us = std::min(std::round(ms * 1000.), static_cast<double>(max_us));
+  auto& count = h_counts[bucket(static_cast<std::uint64_t>(us))];
+  assert(count > 0 && h_total > 0);
+  --count;
+  --h_total;
+  h_sum -= ms;
+}
+
+void hs::Histogram::merge(Histogram const& other) {
+  for (std::size_t b = 0; b < bucket_count; ++b) {
+    h_counts[b] += other.h_counts[b];
+  }
+  h_total += other.h_total;
+  h_max = std::max(h_max, other.h_max);
+  h_sum += other.h_sum;
+}
+
+void hs::Histogram::clear() { *this = Histogram{}; }
+
+std::uint64_t hs::Histogram::count() const { return h_total; }
+
+double hs::Histogram::percentile(double q) const {
+  assert(q >= 0. && q <= 100.);
+  if (h_total == 0) return 0.;
+  // Rank of the duration, from 1 to count()
+  auto rank = static_cast<std::uint64_t>(
+      std::ceil(q / 100. * static_cast<double>(h_total)));
+  rank = std::max(rank, std::uint64_t{1});
+  std::uint64_t seen = 0;
+  for (std::size_t b = 0; b < bucket_count; ++b) {
+    seen += h_counts[b];
+    if (seen >= rank) {
+      auto highest = std::min(lowest(b) + width(b) - 1, h_max);
+      return static_cast<double>(highest) / 1000.;
+    }
+  }
+  return max();
+}
+
+double hs::Histogram::max() const { return static_cast<double>(h_max) / 1000.; }
+
+double hs::Histogram::mean() const {
+  return (h_total == 0) ? 0. : h_sum / static_cast<double>(h_total);
+}
+
+std::uint64_t hs::Histogram::count(std::size_t b) const {
+  assert(b < bucket_count);
+  return h_counts[b];
+}
+
+hs::Rolling::Rolling(std::size_t n) : r_samples(n) { assert(n > 0); }
+
+void hs::Rolling::record(double ms) {
+  if (r_size == r_samples.size()) {
+    r_histogram.remove(r_samples[r_next]);
+  } else {
+    ++r_size;
+  }
+  r_samples[r_next] = ms;
+  r_next = (r_next + 1) % r_samples.size();
+  r_histogram.record(ms);
+}
+
+std::uint64_t hs::Rolling::count() const { return r_histogram.count(); }
+
+// The histogram may hold a longer maximum, already out of the window
+double hs::Rolling::percentile(double q) const {
+  return std::min(r_histogram.percentile(q), max());
+}
+
+double hs::Rolling::max() const {
+  if (r_size == 0) return 0.;
+  auto const last = r_samples.begin() + static_cast<std::ptrdiff_t>(r_size);
+  double longest = *std::max_element(r_samples.begin(), last);
+  return std::round(longest * 1000.) / 1000.;
+}
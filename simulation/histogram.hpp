@@ -0,0 +1,69 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hs {
+// Histogram of durations with log-linear buckets, in fixed memory: each power
+// of two of microseconds is split in 32 buckets, so that percentiles have a
+// relative error below 1 / 32 from 1 us up to about an hour (longer times
+// are counted as an hour)
+class Histogram {
+ public:
+  static constexpr int sub_bits = 5;
+  static constexpr std::size_t sub_count = std::size_t{1} << sub_bits;
+  static constexpr std::size_t bucket_count = (32 - sub_bits + 1) * sub_count;
+
+ private:
+  std::array<std::uint64_t, bucket_count> h_counts{};
+  std::uint64_t h_total{0};
+  std::uint64_t h_max{0};
+  double h_sum{0.};
+
+ public:
+  // Records a duration in milliseconds
+  void record(double);
+  // Removes a duration recorded before; max() keeps the longest one ever
+  // recorded
+  void remove(double);
+  // Adds the counts of another histogram
+  void merge(Histogram const&);
+  void clear();
+
+  std::uint64_t count() const;
+  // Duration (ms) such that q percent of the recorded ones are not longer,
+  // with q in [0, 100]: the highest value of its bucket, at most max()
+  double percentile(double) const;
+  double max() const;
+  double mean() const;
+
+  // Bucket of a duration in microseconds, and the range of durations (us) in
+  // a bucket: [lowest, lowest + width)
+  static std::size_t bucket(std::uint64_t);
+  static std::uint64_t lowest(std::size_t);
+  static std::uint64_t width(std::size_t);
+  std::uint64_t count(std::size_t) const;
+};
+
+// Histogram of the last n durations recorded. They are kept in a ring buffer,
+// so that the oldest one is removed from the counts when a new one comes in
+class Rolling {
+  std::vector<double> r_samples;
+  std::size_t r_next{0};
+  std::size_t r_size{0};
+  Histogram r_histogram;
+
+ public:
+  explicit Rolling(std::size_t);
+  void record(double);
+  std::uint64_t count() const;
+  // Percentiles and maximum of the durations in the window
+  double percentile(double) const;
+  double max() const;
+};
+}  // namespace hs
+
+#endif
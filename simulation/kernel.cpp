@@ -0,0 +1,207 @@
+#include "kernel.hpp"
+
+#include <cassert>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KN_X86 1
+#include <immintrin.h>
+#else
+#define KN_X86 0
+#endif
+
+kn::Query kn::make_query(double x, double y, double vx, double vy,
+                         double cos_view, double d, double d_s) {
+  assert(cos_view <= 1. && d >= 0. && d_s >= 0.);
+  // A still boid looks along the y axis, as its angle is 0
+  double speed = std::sqrt(vx * vx + vy * vy);
+  double hx = (speed > 0.) ? vx / speed : 0.;
+  double hy = (speed > 0.) ? vy / speed : 1.;
+  return Query{x, y, vx, vy, hx, hy, cos_view, d * d, d_s * d_s};
+}
+
+// Scalar version, also used for the tails of the vectorized ones
+static void accumulate_scalar(kn::Query const& q, kn::Candidates const& c,
+                              std::size_t begin, std::size_t end,
+                              kn::Sums& sums) {
+  for (std::size_t k = begin; k < end; ++k) {
+    double dx = c.x[k] - q.x;
+    double dy = c.y[k] - q.y;
+    if (!kn::is_neighbour(q, dx, dy)) continue;
+    if (dx * dx + dy * dy < q.ds2) {
+      sums.sep_x += dx;
+      sums.sep_y += dy;
+    }
+    sums.dx += dx;
+    sums.dy += dy;
+    sums.dvx += c.vx[k] - q.vx;
+    sums.dvy += c.vy[k] - q.vy;
+    sums.count += 1.;
+  }
+}
+
+#if KN_X86
+// Horizontal sums of the lanes of a register
+static double hsum(__m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+__attribute__((target("avx2"))) static double hsum(__m256d v) {
+  return hsum(
+      _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+}
+
+// Two candidates per instruction; SSE2 is always available on x86-64
+static void accumulate_sse2(kn::Query const& q, kn::Candidates const& c,
+                            std::size_t begin, std::size_t end,
+                            kn::Sums& sums) {
+  __m128d const qx = _mm_set1_pd(q.x);
+  __m128d const qy = _mm_set1_pd(q.y);
+  __m128d const qvx = _mm_set1_pd(q.vx);
+  __m128d const qvy = _mm_set1_pd(q.vy);
+  __m128d const hx = _mm_set1_pd(q.hx);
+  __m128d const hy = _mm_set1_pd(q.hy);
+  __m128d const cos_view = _mm_set1_pd(q.cos_view);
+  __m128d const d2_max = _mm_set1_pd(q.d2);
+  __m128d const ds2 = _mm_set1_pd(q.ds2);
+  __m128d const zero = _mm_setzero_pd();
+  __m128d const one = _mm_set1_pd(1.);
+
+  __m128d sep_x = zero;
+  __m128d sep_y = zero;
+  __m128d sum_dx = zero;
+  __m128d sum_dy = zero;
+  __m128d sum_dvx = zero;
+  __m128d sum_dvy = zero;
+  __m128d count = zero;
+
+  std::size_t k = begin;
+  for (; k + 2 <= end; k += 2) {
+    __m128d dx = _mm_sub_pd(_mm_loadu_pd(c.x + k), qx);
+    __m128d dy = _mm_sub_pd(_mm_loadu_pd(c.y + k), qy);
+    __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+    __m128d dot = _mm_add_pd(_mm_mul_pd(hx, dx), _mm_mul_pd(hy, dy));
+    // Distance, coincidence and view cone masks
+    __m128d mask =
+        _mm_and_pd(_mm_cmplt_pd(d2, d2_max), _mm_cmpgt_pd(d2, zero));
+    mask = _mm_and_pd(
+        mask, _mm_cmpge_pd(dot, _mm_mul_pd(cos_view, _mm_sqrt_pd(d2))));
+    __m128d sep_mask = _mm_and_pd(mask, _mm_cmplt_pd(d2, ds2));
+
+    sep_x = _mm_add_pd(sep_x, _mm_and_pd(sep_mask, dx));
+    sep_y = _mm_add_pd(sep_y, _mm_and_pd(sep_mask, dy));
+    sum_dx = _mm_add_pd(sum_dx, _mm_and_pd(mask, dx));
+    sum_dy = _mm_add_pd(sum_dy, _mm_and_pd(mask, dy));
+    __m128d dvx = _mm_sub_pd(_mm_loadu_pd(c.vx + k), qvx);
+    __m128d dvy = _mm_sub_pd(_mm_loadu_pd(c.vy + k), qvy);
+    sum_dvx = _mm_add_pd(sum_dvx, _mm_and_pd(mask, dvx));
+    sum_dvy = _mm_add_pd(sum_dvy, _mm_and_pd(mask, dvy));
+    count = _mm_add_pd(count, _mm_and_pd(mask, one));
+  }
+
+  sums.sep_x += hsum(sep_x);
+  sums.sep_y += hsum(sep_y);
+  sums.dx += hsum(sum_dx);
+  sums.dy += hsum(sum_dy);
+  sums.dvx += hsum(sum_dvx);
+  sums.dvy += hsum(sum_dvy);
+  sums.count += hsum(count);
+
+  accumulate_scalar(q, c, k, end, sums);
+}
+
+// Four candidates per instruction, compiled for AVX2 only in this function
+__attribute__((target("avx2"))) static void accumulate_avx2(
+    kn::Query const& q, kn::Candidates const& c, std::size_t begin,
+    std::size_t end, kn::Sums& sums) {
+  __m256d const qx = _mm256_set1_pd(q.x);
+  __m256d const qy = _mm256_set1_pd(q.y);
+  __m256d const qvx = _mm256_set1_pd(q.vx);
+  __m256d const qvy = _mm256_set1_pd(q.vy);
+  __m256d const hx = _mm256_set1_pd(q.hx);
+  __m256d const hy = _mm256_set1_pd(q.hy);
+  __m256d const cos_view = _mm256_set1_pd(q.cos_view);
+  __m256d const d2_max = _mm256_set1_pd(q.d2);
+  __m256d const ds2 = _mm256_set1_pd(q.ds2);
+  __m256d const zero = _mm256_setzero_pd();
+  __m256d const one = _mm256_set1_pd(1.);
+
+  __m256d sep_x = zero;
+  __m256d sep_y = zero;
+  __m256d sum_dx = zero;
+  __m256d sum_dy = zero;
+  __m256d sum_dvx = zero;
+  __m256d sum_dvy = zero;
+  __m256d count = zero;
+
+  std::size_t k = begin;
+  for (; k + 4 <= end; k += 4) {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(c.x + k), qx);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(c.y + k), qy);
+    __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+    __m256d dot = _mm256_add_pd(_mm256_mul_pd(hx, dx), _mm256_mul_pd(hy, dy));
+    // Distance, coincidence and view cone masks
+    __m256d mask = _mm256_and_pd(_mm256_cmp_pd(d2, d2_max, _CMP_LT_OQ),
+                                 _mm256_cmp_pd(d2, zero, _CMP_GT_OQ));
+    mask = _mm256_and_pd(
+        mask, _mm256_cmp_pd(dot, _mm256_mul_pd(cos_view, _mm256_sqrt_pd(d2)),
+                            _CMP_GE_OQ));
+    __m256d sep_mask = _mm256_and_pd(mask, _mm256_cmp_pd(d2, ds2, _CMP_LT_OQ));
+
+    sep_x = _mm256_add_pd(sep_x, _mm256_and_pd(sep_mask, dx));
+    sep_y = _mm256_add_pd(sep_y, _mm256_and_pd(sep_mask, dy));
+    sum_dx = _mm256_add_pd(sum_dx, _mm256_and_pd(mask, dx));
+    sum_dy = _mm256_add_pd(sum_dy, _mm256_and_pd(mask, dy));
+    __m256d dvx = _mm256_sub_pd(_mm256_loadu_pd(c.vx + k), qvx);
+    __m256d dvy = _mm256_sub_pd(_mm256_loadu_pd(c.vy + k), qvy);
+    sum_dvx = _mm256_add_pd(sum_dvx, _mm256_and_pd(mask, dvx));
+    sum_dvy = _mm256_add_pd(sum_dvy, _mm256_and_pd(mask, dvy));
+    count = _mm256_add_pd(count, _mm256_and_pd(mask, one));
+  }
+
+  sums.sep_x += hsum(sep_x);
+  sums.sep_y += hsum(sep_y);
+  sums.dx += hsum(sum_dx);
+  sums.dy += hsum(sum_dy);
+  sums.dvx += hsum(sum_dvx);
+  sums.dvy += hsum(sum_dvy);
+  sums.count += hsum(count);
+
+  accumulate_scalar(q, c, k, end, sums);
+}
+#endif
+
+kn::Isa kn::best_isa() {
+#if KN_X86
+  static Isa const isa = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? Isa::avx2 : Isa::sse2;
+  }();
+  return isa;
+#else
+  return Isa::scalar;
+#endif
+}
+
+void kn::accumulate(kn::Query const& q, kn::Candidates const& c,
+                    std::size_t begin, std::size_t end, kn::Sums& sums) {
+  accumulate(best_isa(), q, c, begin, end, sums);
+}
+
+void kn::accumulate(kn::Isa isa, kn::Query const& q, kn::Candidates const& c,
+                    std::size_t begin, std::size_t end, kn::Sums& sums) {
+  assert(begin <= end &&
+         static_cast<int>(isa) <= static_cast<int>(best_isa()));
+  switch (isa) {
+#if KN_X86
+    case Isa::avx2:
+      accumulate_avx2(q, c, begin, end, sums);
+      break;
+    case Isa::sse2:
+      accumulate_sse2(q, c, begin, end, sums);
+      break;
+#endif
+    default:
+      accumulate_scalar(q, c, begin, end, sums);
+      break;
+  }
+}
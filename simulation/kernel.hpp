@@ -0,0 +1,68 @@
+#ifndef KERNEL_HPP
+#define KERNEL_HPP
+
+#include <cmath>
+#include <cstddef>
+
+namespace kn {
+// Boid whose neighbours are searched: position, velocity, unit heading and
+// the squared distances (d and d_s) used by the flocking rules
+struct Query {
+  double x;
+  double y;
+  double vx;
+  double vy;
+  double hx;
+  double hy;
+  // cos(view_angle): a value below -1 accepts every direction
+  double cos_view;
+  double d2;
+  double ds2;
+};
+
+// Positions and velocities of the candidate neighbours, stored in arrays
+struct Candidates {
+  double const* x;
+  double const* y;
+  double const* vx;
+  double const* vy;
+};
+
+// Sums over the neighbours of relative positions (all of them, and only the
+// ones closer than d_s) and of relative velocities
+struct Sums {
+  double sep_x{0.};
+  double sep_y{0.};
+  double dx{0.};
+  double dy{0.};
+  double dvx{0.};
+  double dvy{0.};
+  double count{0.};
+};
+
+enum class Isa { scalar, sse2, avx2 };
+
+// Builds the query of a boid, taking its heading from the velocity: it takes
+// x, y, vx, vy, the cosine of the view angle (see bd::view_cosine), d and d_s
+Query make_query(double, double, double, double, double, double, double);
+
+// True if the point at relative position (dx, dy) is a neighbour of q: it
+// must be closer than d, not coincident and inside the view cone
+inline bool is_neighbour(Query const& q, double dx, double dy) {
+  double d2 = dx * dx + dy * dy;
+  return d2 < q.d2 && d2 > 0. &&
+         q.hx * dx + q.hy * dy >= q.cos_view * std::sqrt(d2);
+}
+
+// Best instruction set available on this CPU, checked once at runtime
+Isa best_isa();
+
+// Adds to sums the contribution of the candidates in [begin, end), using the
+// best instruction set or the given one
+void accumulate(Query const&, Candidates const&, std::size_t, std::size_t,
+                Sums&);
+void accumulate(Isa, Query const&, Candidates const&, std::size_t,
+                std::size_t, Sums&);
+}  // namespace kn
+
+#endif
@@ -1,37 +1,145 @@
 #ifndef MATH_HPP
 #define MATH_HPP
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
-#include <valarray>
+#include <cstddef>
+#include <execution>
+#include <iterator>
+#include <utility>
 
 namespace mt {
-// It return the norm of a vector
-template <typename T>
-T vec_norm(std::valarray<T> const& vec) {
-  return std::sqrt(std::pow(vec, {2., 2.}).sum());
+// Two-dimensional vector used for positions, velocities and sizes. It is
+// trivially copyable, so it is passed around by value and kept in registers
+struct Vec2 {
+  double x{0.};
+  double y{0.};
+
+  constexpr Vec2() = default;
+  constexpr Vec2(double first, double second) : x{first}, y{second} {}
+
+  constexpr double& operator[](std::size_t i) {
+    assert(i < 2);
+    return (i == 0) ? x : y;
+  }
+  constexpr double operator[](std::size_t i) const {
+    assert(i < 2);
+    return (i == 0) ? x : y;
+  }
+
+  constexpr Vec2& operator+=(Vec2 const& other) {
+    x += other.x;
+    y += other.y;
+    return *this;
+  }
+  constexpr Vec2& operator-=(Vec2 const& other) {
+    x -= other.x;
+    y -= other.y;
+    return *this;
+  }
+  constexpr Vec2& operator*=(double k) {
+    x *= k;
+    y *= k;
+    return *this;
+  }
+  constexpr Vec2& operator/=(double k) {
+    x /= k;
+    y /= k;
+    return *this;
+  }
+
+  constexpr double dot(Vec2 const& other) const {
+    return x * other.x + y * other.y;
+  }
+  constexpr double norm2() const { return x * x + y * y; }
+  double norm() const { return std::sqrt(norm2()); }
+  // Unit vector with the same direction; the null vector is left unchanged
+  Vec2 normalized() const {
+    double n2 = norm2();
+    if (n2 == 0.) return *this;
+    double inv = 1. / std::sqrt(n2);
+    return {x * inv, y * inv};
+  }
+};
+
+constexpr Vec2 operator+(Vec2 const& v1, Vec2 const& v2) {
+  return {v1.x + v2.x, v1.y + v2.y};
+}
+constexpr Vec2 operator-(Vec2 const& v1, Vec2 const& v2) {
+  return {v1.x - v2.x, v1.y - v2.y};
+}
+constexpr Vec2 operator-(Vec2 const& vec) { return {-vec.x, -vec.y}; }
+constexpr Vec2 operator*(Vec2 const& vec, double k) {
+  return {vec.x * k, vec.y * k};
+}
+constexpr Vec2 operator*(double k, Vec2 const& vec) {
+  return {k * vec.x, k * vec.y};
+}
+constexpr Vec2 operator/(Vec2 const& vec, double k) {
+  return {vec.x / k, vec.y / k};
+}
+constexpr bool operator==(Vec2 const& v1, Vec2 const& v2) {
+  return v1.x == v2.x && v1.y == v2.y;
+}
+constexpr bool operator!=(Vec2 const& v1, Vec2 const& v2) {
+  return !(v1 == v2);
 }
 
-// It computes the angle of the vector
+// It return the norm of a vector
+inline double vec_norm(Vec2 const& vec) { return vec.norm(); }
+
+// It computes the angle of the vector (x, y)
 template <typename T>
-T compute_angle(std::valarray<T> const& vec) {
-  // assert(vec.size() == 2);
+T compute_angle(T x, T y) {
   double angle{0.};
-  if (vec[1] == 0. && vec[0] < 0.) {
+  if (y == 0. && x < 0.) {
     angle = -90.;
-  } else if (vec[1] == 0. && vec[0] > 0.) {
+  } else if (y == 0. && x > 0.) {
     angle = 90.;
-  } else if (vec[1] == 0. && vec[0] == 0.) {
+  } else if (y == 0. && x == 0.) {
     angle = 0.;
-  } else if (vec[0] == 0. && vec[1] > 0.) {
+  } else if (x == 0. && y > 0.) {
     angle = 0.;
-  } else if (vec[0] == 0. && vec[1] < 0.) {
+  } else if (x == 0. && y < 0.) {
     angle = 180.;
   } else {
-    angle = std::atan(vec[0] / vec[1]) / M_PI * 180;
-    (vec[1] < 0. && vec[0] < 0.) ? angle -= 180. : angle;
-    (vec[1] < 0. && vec[0] > 0.) ? angle += 180. : angle;
+    angle = std::atan(x / y) / M_PI * 180;
+    (y < 0. && x < 0.) ? angle -= 180. : angle;
+    (y < 0. && x > 0.) ? angle += 180. : angle;
   }
   return angle;
 }
+
+// It computes the angle of the vector
+inline double compute_angle(Vec2 const& vec) {
+  return compute_angle<double>(vec.x, vec.y);
+}
+
+// Sorts a range expected to be almost sorted, like positions that were sorted
+// in the previous step: insertion sort is linear in that case, and stable.
+// Once more than max_shifts shifts are needed it falls back to a parallel
+// std::sort. It returns the number of shifts done by insertion sort
+template <typename It, typename Less>
+std::size_t incremental_sort(It first, It last, Less less,
+                             std::size_t max_shifts) {
+  std::size_t shifts{0};
+  for (It it = first; it != last; ++it) {
+    if (it == first || !less(*it, *std::prev(it))) continue;
+    auto value = std::move(*it);
+    It hole = it;
+    do {
+      *hole = std::move(*std::prev(hole));
+      --hole;
+      ++shifts;
+    } while (hole != first && less(value, *std::prev(hole)));
+    *hole = std::move(value);
+    if (shifts > max_shifts) {
+      std::sort(std::execution::par, first, last, less);
+      break;
+    }
+  }
+  return shifts;
+}
 }  // namespace mt
 #endif
\ No newline at end of file
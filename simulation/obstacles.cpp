@@ -2,11 +2,14 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <random>
 
-ob::Obstacle::Obstacle(std::valarray<double> const& pos, double size) {
-  assert(size > 0 && pos.size() == 2);
+#include "random.hpp"
+
+ob::Obstacle::Obstacle(mt::Vec2 const& pos, double size) {
+  assert(size > 0);
   o_size = size;
   o_pos = pos;
 }
@@ -17,19 +20,19 @@ ob::Obstacle::Obstacle(double pos_x, double pos_y, double size) {
   o_pos = {pos_x, pos_y};
 }
 
-std::valarray<double> const& ob::Obstacle::get_pos() const { return o_pos; }
+mt::Vec2 const& ob::Obstacle::get_pos() const { return o_pos; }
 
 double ob::Obstacle::get_size() const { return o_size; }
 
 // VECTOR OF OBSTACLES
 
 std::vector<ob::Obstacle> ob::generate_obstacles(
-    int n_obstacles, double max_size, std::valarray<double> const& space) {
+    int n_obstacles, double max_size, mt::Vec2 const& space) {
   // Generates randomly the positions of the obstacles
   assert(n_obstacles >= 0);
   std::vector<ob::Obstacle> g_obstacles;
 
-  std::random_device rd;
+  auto rd = rn::engine();
   double x_max = (space[0] - 4.5 * max_size);
   double y_max = (space[1] - 4.5 * max_size);
 
@@ -38,7 +41,7 @@ std::vector<ob::Obstacle> ob::generate_obstacles(
   std::uniform_real_distribution<> size(15., max_size);
 
   for (auto n = 0; n < n_obstacles; ++n) {
-    std::valarray<double> pos = {dist_pos_x(rd), dist_pos_y(rd)};
+    mt::Vec2 pos = {dist_pos_x(rd), dist_pos_y(rd)};
     g_obstacles.push_back(ob::Obstacle{pos, size(rd)});
   }
 
@@ -47,7 +50,7 @@ std::vector<ob::Obstacle> ob::generate_obstacles(
   // Checks if there are overlapping obstacles and removes overlapping ones
 
   auto overlap = [&](ob::Obstacle& obs1, ob::Obstacle& obs2) {
-    return (mt::vec_norm<double>(obs1.get_pos() - obs2.get_pos()) <
+    return (mt::vec_norm(obs1.get_pos() - obs2.get_pos()) <
             obs1.get_size() + obs2.get_size());
   };
   auto last = std::unique(g_obstacles.begin(), g_obstacles.end(), overlap);
@@ -57,7 +60,7 @@ std::vector<ob::Obstacle> ob::generate_obstacles(
   while (g_obstacles.size() < static_cast<unsigned int>(n_obstacles)) {
     for (int i = 0; i < n_obstacles - static_cast<int>(g_obstacles.size());
          ++i) {
-      std::valarray<double> pos = {dist_pos_x(rd), dist_pos_y(rd)};
+      mt::Vec2 pos = {dist_pos_x(rd), dist_pos_y(rd)};
       g_obstacles.push_back(ob::Obstacle{pos, size(rd)});
     }
     ob::sort_obstacles(g_obstacles);
@@ -68,19 +71,23 @@ std::vector<ob::Obstacle> ob::generate_obstacles(
   return g_obstacles;
 }
 
+// True if a circle of the given size in pos is far enough from the borders
+static bool inside(mt::Vec2 const& pos, double size, mt::Vec2 const& space) {
+  return pos[0] >= size && pos[1] >= size && space[0] - pos[0] >= size &&
+         space[1] - pos[1] >= size;
+}
+
 bool ob::add_obstacle(std::vector<ob::Obstacle>& g_obstacles,
-                      std::valarray<double> const& pos, double max_size,
-                      std::valarray<double> const& space) {
-  std::random_device rd;
+                      mt::Vec2 const& pos, double max_size,
+                      mt::Vec2 const& space) {
+  auto rd = rn::engine();
   std::uniform_real_distribution<> ran_size(15., max_size);
   double size = ran_size(rd);
-  if (pos[0] < size || pos[1] < size || (space[0] - pos[0]) < size ||
-      (space[1] - pos[1]) < size || pos[0] > space[0] || pos[1] > space[1])
-    return false;
+  if (!inside(pos, size, space)) return false;
 
   // Checks if it overlaps with another obstacle or with borders
   auto overlap = [&](ob::Obstacle const& obs) {
-    return (mt::vec_norm<double>(obs.get_pos() - pos) < obs.get_size() + size);
+    return (mt::vec_norm(obs.get_pos() - pos) < obs.get_size() + size);
   };
 
   // If it doesn't, it pushbacks obstacle in the vector and returns true, if it
@@ -93,26 +100,44 @@ bool ob::add_obstacle(std::vector<ob::Obstacle>& g_obstacles,
   }
 }
 
-void ob::add_fixed_obstacle(std::vector<ob::Obstacle>& g_obstacles,
-                            std::valarray<double> const& pos, double size,
-                            std::valarray<double> const& space) {
-  ob::sort_obstacles(g_obstacles);
+bool ob::add_obstacle(std::vector<ob::Obstacle>& g_obstacles,
+                      ob::ObstacleGrid& grid, mt::Vec2 const& pos,
+                      double max_size, mt::Vec2 const& space) {
+  // The grid must index the same obstacles as the vector
+  assert(grid.size() == g_obstacles.size());
+  auto rd = rn::engine();
+  std::uniform_real_distribution<> ran_size(15., max_size);
+  double size = ran_size(rd);
+  if (!inside(pos, size, space) || grid.overlaps(pos, size)) return false;
 
+  g_obstacles.push_back(ob::Obstacle(pos, size));
+  grid.insert(g_obstacles.back());
+  return true;
+}
+
+void ob::add_fixed_obstacle(std::vector<ob::Obstacle>& g_obstacles,
+                            mt::Vec2 const& pos, double size,
+                            mt::Vec2 const& space) {
   // Checks if it overlaps with another obstacle or with borders
-  auto overlap = [&](ob::Obstacle& obs) {
-    return (std::abs(pos[0] - obs.get_pos()[0]) < obs.get_size() + size ||
-            std::abs((pos[1] - obs.get_pos()[1])) < obs.get_size() + size ||
-            pos[0] < size || pos[1] < size ||
-            std::abs(pos[0] - space[0]) < size ||
-            std::abs(pos[1] - space[1]) < size);
+  auto overlap = [&](ob::Obstacle const& obs) {
+    return (mt::vec_norm(obs.get_pos() - pos) < obs.get_size() + size);
   };
 
-  // If it doesn't, it pushbacks obstacle in the vectorif it
+  // If it doesn't, it inserts the obstacle keeping the vector sorted, if it
   // does, it prints at screen "Impossible to add obstacles"
-  auto it = std::find_if(g_obstacles.begin(), g_obstacles.end(), overlap);
-  if (it == g_obstacles.end()) {
-    g_obstacles.push_back(ob::Obstacle(pos, size));
-    ob::sort_obstacles(g_obstacles);
+  if (inside(pos, size, space) &&
+      std::none_of(g_obstacles.begin(), g_obstacles.end(), overlap)) {
+    ob::Obstacle obstacle(pos, size);
+    auto it = std::upper_bound(
+        g_obstacles.begin(), g_obstacles.end(), obstacle,
+        [](ob::Obstacle const& obs1, ob::Obstacle const& obs2) {
+          if (obs1.get_pos()[0] != obs2.get_pos()[0]) {
+            return obs1.get_pos()[0] < obs2.get_pos()[0];
+          } else {
+            return obs1.get_pos()[1] < obs2.get_pos()[1];
+          }
+        });
+    g_obstacles.insert(it, obstacle);
   } else {
     std::cout << "Impossible to add this obstacle" << '\n';
   }
@@ -129,3 +154,89 @@ void ob::sort_obstacles(std::vector<ob::Obstacle>& g_obstacles) {
   std::sort(std::execution::par, g_obstacles.begin(), g_obstacles.end(),
             is_less);
 }
+
+// OBSTACLE GRID
+
+void ob::ObstacleGrid::build(std::vector<ob::Obstacle> const& obstacles,
+                             mt::Vec2 const& space) {
+  assert(space[0] > 0. && space[1] > 0.);
+  og_space = space;
+  og_obstacles.clear();
+  og_max_size = 0.;
+  for (auto const& obs : obstacles) {
+    og_max_size = std::max(og_max_size, obs.get_size());
+  }
+  // Cells hold a few obstacles each, and are not smaller than the biggest one
+  double n = static_cast<double>(obstacles.size());
+  og_cell = std::max(2. * og_max_size,
+                     std::sqrt(space[0] * space[1] / (n + 64.)));
+  og_cols = static_cast<std::size_t>(std::ceil(space[0] / og_cell));
+  og_rows = static_cast<std::size_t>(std::ceil(space[1] / og_cell));
+  (og_cols == 0) ? og_cols = 1 : og_cols;
+  (og_rows == 0) ? og_rows = 1 : og_rows;
+  og_cells.assign(og_cols * og_rows, {});
+  og_built = obstacles.size();
+  ++og_version;
+  for (auto const& obs : obstacles) insert(obs);
+}
+
+void ob::ObstacleGrid::update(std::vector<ob::Obstacle> const& obstacles,
+                              mt::Vec2 const& space) {
+  auto same = [](ob::Obstacle const& ob1, ob::Obstacle const& ob2) {
+    return ob1.get_pos() == ob2.get_pos() && ob1.get_size() == ob2.get_size();
+  };
+  if (space == og_space && obstacles.size() >= og_obstacles.size() &&
+      std::equal(og_obstacles.begin(), og_obstacles.end(), obstacles.begin(),
+                 same)) {
+    for (auto it = obstacles.begin() +
+                   static_cast<std::ptrdiff_t>(og_obstacles.size());
+         it != obstacles.end(); ++it) {
+      insert(*it);
+    }
+  } else {
+    build(obstacles, space);
+  }
+}
+
+void ob::ObstacleGrid::insert(ob::Obstacle const& obstacle) {
+  ++og_version;
+  og_obstacles.push_back(obstacle);
+  og_max_size = std::max(og_max_size, obstacle.get_size());
+  og_cells[row(obstacle.get_pos()[1]) * og_cols + col(obstacle.get_pos()[0])]
+      .push_back(og_obstacles.size() - 1);
+  // Once the number of obstacles has doubled, cells are made smaller
+  if (og_obstacles.size() > 2 * og_built + 64) {
+    std::vector<ob::Obstacle> obstacles;
+    obstacles.swap(og_obstacles);
+    build(obstacles, og_space);
+  }
+}
+
+bool ob::ObstacleGrid::overlaps(mt::Vec2 const& pos, double size) const {
+  bool found{false};
+  for_each_near(pos, size, [&](ob::Obstacle const& obs) {
+    (mt::vec_norm(obs.get_pos() - pos) < obs.get_size() + size) ? found = true
+                                                                : found;
+  });
+  return found;
+}
+
+std::size_t ob::ObstacleGrid::size() const { return og_obstacles.size(); }
+
+std::size_t ob::ObstacleGrid::get_version() const { return og_version; }
+
+std::vector<ob::Obstacle> const& ob::ObstacleGrid::get_obstacles() const {
+  return og_obstacles;
+}
+
+std::size_t ob::ObstacleGrid::col(double x) const {
+  if (!(x > 0.)) return 0;
+  auto c = static_cast<std::size_t>(x / og_cell);
+  return (c < og_cols) ? c : og_cols - 1;
+}
+
+std::size_t ob::ObstacleGrid::row(double y) const {
+  if (!(y > 0.)) return 0;
+  auto r = static_cast<std::size_t>(y / og_cell);
+  return (r < og_rows) ? r : og_rows - 1;
+}
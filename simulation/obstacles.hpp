@@ -3,24 +3,24 @@
 
 #include <cassert>
 #include <execution>
+#include <vector>
 
 #include "math.hpp"
 namespace ob {
 class Obstacle {
-  std::valarray<double> o_pos;
+  mt::Vec2 o_pos;
   double o_size;
 
  public:
-  Obstacle(std::valarray<double> const&, double);
+  Obstacle(mt::Vec2 const&, double);
   Obstacle(double, double, double);
   Obstacle() = default;
-  std::valarray<double> const& get_pos() const;
+  mt::Vec2 const& get_pos() const;
   double get_size() const;
 };
 
 // Generate a random vector of obstacles
-std::vector<Obstacle> generate_obstacles(int, double,
-                                         std::valarray<double> const&);
+std::vector<Obstacle> generate_obstacles(int, double, mt::Vec2 const&);
 
 // It sorts the vector in ascending order according to x_position. If x_positons
 // are the same, it sorts according to y_positions
@@ -28,12 +28,64 @@ void sort_obstacles(std::vector<Obstacle>&);
 
 // Adds an obstacle with random size, and returns true in case it can add it,
 // returns false in case it can't
-bool add_obstacle(std::vector<Obstacle>&, std::valarray<double> const&, double,
-                  std::valarray<double> const&);
+bool add_obstacle(std::vector<Obstacle>&, mt::Vec2 const&, double,
+                  mt::Vec2 const&);
 
 // Add_obstacle WITHOUT random size, used in tests
-void add_fixed_obstacle(std::vector<Obstacle>& g_obstacles,
-                        std::valarray<double> const& pos, double size,
-                        std::valarray<double> const& space);
+void add_fixed_obstacle(std::vector<Obstacle>& g_obstacles, mt::Vec2 const& pos,
+                        double size, mt::Vec2 const& space);
+
+// Broadphase over obstacles: a uniform grid where each cell lists the
+// obstacles whose centre lies in it. Obstacles can be inserted one at a time;
+// the grid is rebuilt, with smaller cells, only when it becomes crowded
+class ObstacleGrid {
+  double og_cell{1.};
+  std::size_t og_cols{1};
+  std::size_t og_rows{1};
+  mt::Vec2 og_space;
+  std::vector<std::vector<std::size_t>> og_cells{1};
+  // Obstacles indexed by the grid, also used to detect changes
+  std::vector<Obstacle> og_obstacles;
+  double og_max_size{0.};
+  // Number of obstacles when the grid was last built
+  std::size_t og_built{0};
+  // Incremented at every change of the obstacles
+  std::size_t og_version{0};
+
+  // Column and row of a position, clamped to the border cells
+  std::size_t col(double) const;
+  std::size_t row(double) const;
+
+ public:
+  void build(std::vector<Obstacle> const&, mt::Vec2 const&);
+  // Brings the grid up to date: obstacles appended since the last call are
+  // inserted, any other change rebuilds it
+  void update(std::vector<Obstacle> const&, mt::Vec2 const&);
+  void insert(Obstacle const&);
+  // True if a circle in pos with the given size overlaps an obstacle
+  bool overlaps(mt::Vec2 const&, double) const;
+  std::size_t size() const;
+  std::size_t get_version() const;
+  std::vector<Obstacle> const& get_obstacles() const;
+
+  // Calls f(obstacle) for each obstacle that may be closer than its size plus
+  // margin to pos; others are skipped
+  template <typename F>
+  void for_each_near(mt::Vec2 const& pos, double margin, F&& f) const {
+    double r = og_max_size + margin;
+    std::size_t first_col = col(pos.x - r);
+    std::size_t last_col = col(pos.x + r);
+    for (std::size_t r_y = row(pos.y - r); r_y <= row(pos.y + r); ++r_y) {
+      for (std::size_t c_x = first_col; c_x <= last_col; ++c_x) {
+        for (auto i : og_cells[r_y * og_cols + c_x]) f(og_obstacles[i]);
+      }
+    }
+  }
+};
+
+// add_obstacle checking overlaps through a grid built on the same obstacles,
+// which is kept updated
+bool add_obstacle(std::vector<Obstacle>&, ObstacleGrid&, mt::Vec2 const&,
+                  double, mt::Vec2 const&);
 }  // namespace ob
 #endif
\ No newline at end of file
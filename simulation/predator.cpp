@@ -1,13 +1,17 @@
 #include "predator.hpp"
 
 #include <algorithm>
+#include <cassert>
+#include <execution>
+#include <numeric>
 #include <random>
 
-pr::Predator::Predator(std::valarray<double> const& pos,
-                       std::valarray<double> const& vel, double view_ang,
-                       double param_d_s, double param_s,
-                       std::valarray<double> const& space, double range,
-                       double hunger)
+#include "random.hpp"
+#include "trace.hpp"
+
+pr::Predator::Predator(mt::Vec2 const& pos, mt::Vec2 const& vel,
+                       double view_ang, double param_d_s, double param_s,
+                       mt::Vec2 const& space, double range, double hunger)
     : bd::Boid(pos, vel, view_ang, space, param_d_s, param_s),
       p_range(range),
       p_hunger(hunger) {}
@@ -25,41 +29,46 @@ double pr::Predator::get_range() const { return p_range; }
 
 double pr::Predator::get_hunger() const { return p_hunger; }
 
-// it sorts preys according to x position and calculates the centre of mass of
-// its preys
-std::valarray<double> pr::Predator::predate(std::vector<bd::Boid>& preys) {
-  std::valarray<double> prey_com_pos(2);
-  if (preys.size() > 0) {
-    auto nearest = [&](bd::Boid const& b1, bd::Boid const& b2) {
-      return boid_dist(b1, *this) < boid_dist(b2, *this);
-    };
+// It calculates the centre of mass of its preys and finds the nearest one
+mt::Vec2 pr::Predator::predate(std::vector<bd::Boid> const& preys) const {
+  return predate(preys.data(), preys.data() + preys.size());
+}
 
-    std::sort(preys.begin(), preys.end(), nearest);
-    for (auto const& prey : preys) {
-      prey_com_pos += prey.get_pos();
+mt::Vec2 pr::Predator::predate(bd::Boid const* first,
+                               bd::Boid const* last) const {
+  if (first == last) return mt::Vec2{0., 0.};
+
+  // A single pass sums positions and keeps the nearest prey
+  mt::Vec2 prey_com_pos{0., 0.};
+  bd::Boid const* nearest = first;
+  double nearest_dist2 = (first->get_pos() - get_pos()).norm2();
+  for (auto prey = first; prey != last; ++prey) {
+    prey_com_pos += prey->get_pos();
+    double dist2 = (prey->get_pos() - get_pos()).norm2();
+    if (dist2 < nearest_dist2) {
+      nearest_dist2 = dist2;
+      nearest = prey;
     }
+  }
 
-    prey_com_pos /= static_cast<double>(preys.size());
+  double const n_preys = static_cast<double>(last - first);
+  prey_com_pos /= n_preys;
 
-    // It returns a vel correction proportional to the distance aqay from local
-    // preys' centre of mass and proportional to its nearest prey
-    return p_hunger * (prey_com_pos - get_pos()) +
-           p_hunger * (static_cast<double>(preys.size())) *
-               (preys[0].get_pos() - get_pos());
-  } else {
-    return std::valarray<double>{0., 0.};
-  }
+  // It returns a vel correction proportional to the distance aqay from local
+  // preys' centre of mass and proportional to its nearest prey
+  return p_hunger * (prey_com_pos - get_pos()) +
+         p_hunger * n_preys * (nearest->get_pos() - get_pos());
 }
 
 std::vector<pr::Predator> pr::random_predators(
     std::vector<ob::Obstacle> const& obs, int pred_num,
-    std::valarray<double> const& pred_space, double pred_view_ang,
-    double pred_ds, double pred_s, double pred_range, double pred_hunger) {
+    mt::Vec2 const& pred_space, double pred_view_ang, double pred_ds,
+    double pred_s, double pred_range, double pred_hunger) {
   std::vector<pr::Predator> predators;
   assert(pred_num >= 0 && pred_view_ang > 0. && pred_ds > 0. && pred_s > 0. &&
          pred_range > 0. && pred_hunger > 0.);
   if (pred_num == 0) return predators;
-  std::random_device rd;
+  auto rd = rn::engine();
   int x_max = static_cast<int>(2.5 * (pred_space[0] - 40.) / pred_ds);
   int y_max = static_cast<int>(2.5 * (pred_space[1] - 40.) / pred_ds);
 
@@ -73,14 +82,14 @@ std::vector<pr::Predator> pr::random_predators(
                     &pred_space, &pred_view_ang, &pred_ds, &pred_s, &pred_range,
                     &pred_hunger, &obs]() -> pr::Predator {
     // It generates the positons
-    std::valarray<double> pos = {
+    mt::Vec2 pos = {
         static_cast<double>(dist_pos_x(rd)) * 0.4 * (pred_ds) + 20.,
         static_cast<double>(dist_pos_y(rd)) * 0.4 * (pred_ds) + 20.};
 
     // Checks wheter there're are no oveerlapping obstacles
     auto overlap = [&pos, &pred_ds](ob::Obstacle const& obstacle) -> bool {
-      std::valarray<double> dist = pos - obstacle.get_pos();
-      return mt::vec_norm<double>(dist) < obstacle.get_size() + 0.6 * pred_ds;
+      mt::Vec2 dist = pos - obstacle.get_pos();
+      return mt::vec_norm(dist) < obstacle.get_size() + 0.6 * pred_ds;
     };
 
     while (std::any_of(obs.begin(), obs.end(), overlap)) {
@@ -90,7 +99,7 @@ std::vector<pr::Predator> pr::random_predators(
     }
     // If there are no predators overlapping with obstacles, it returns the
     // predator
-    std::valarray<double> vel = {dist_vel_x(rd), dist_vel_y(rd)};
+    mt::Vec2 vel = {dist_vel_x(rd), dist_vel_y(rd)};
     return pr::Predator{pos,    vel,        pred_view_ang, pred_ds,
                         pred_s, pred_space, pred_range,    pred_hunger};
   };
@@ -127,12 +136,12 @@ std::vector<pr::Predator> pr::random_predators(
 
 void pr::add_predator(std::vector<pr::Predator>& predators,
                       std::vector<ob::Obstacle> const& obstacles,
-                      std::valarray<double> const& pred_space, double pred_ang,
+                      mt::Vec2 const& pred_space, double pred_ang,
                       double pred_ds, double pred_s, double pred_range,
                       double pred_hunger) {
   assert(pred_space[0] > 0 && pred_space[1] > 0 && pred_ang > 0. &&
          pred_ds > 0. && pred_s >= 0. && pred_range > 0. && pred_hunger > 0.);
-  std::random_device rd;
+  auto rd = rn::engine();
   int x_max = static_cast<int>(2.5 * (pred_space[0] - 40.) / pred_ds);
   int y_max = static_cast<int>(2.5 * (pred_space[1] - 40.) / pred_ds);
 
@@ -142,17 +151,16 @@ void pr::add_predator(std::vector<pr::Predator>& predators,
   std::uniform_real_distribution<> dist_vel_x(-150., 150.);
   std::uniform_real_distribution<> dist_vel_y(-150., 150.);
 
-  std::valarray<double> pos = {
+  mt::Vec2 pos = {
       static_cast<double>(dist_pos_x(rd)) * 0.4 * (pred_ds) + 20.,
       static_cast<double>(dist_pos_y(rd)) * 0.4 * (pred_ds) + 20.};
 
   auto overlap_pred = [&pos, &pred_ds](pr::Predator& p1) -> bool {
-    return mt::vec_norm<double>(static_cast<std::valarray<double>>(
-               p1.get_pos() - pos)) < 0.6 * pred_ds;
+    return mt::vec_norm(p1.get_pos() - pos) < 0.6 * pred_ds;
   };
   auto overlap_obs = [&pos, &pred_ds](ob::Obstacle const& obstacle) -> bool {
-    std::valarray<double> dist = pos - obstacle.get_pos();
-    return mt::vec_norm<double>(dist) < obstacle.get_size() + 0.6 * pred_ds;
+    mt::Vec2 dist = pos - obstacle.get_pos();
+    return mt::vec_norm(dist) < obstacle.get_size() + 0.6 * pred_ds;
   };
 
   // Until predator overlaps with obstacles or other predators, it regenerates
@@ -163,7 +171,7 @@ void pr::add_predator(std::vector<pr::Predator>& predators,
   }
 
   // Adds predator
-  std::valarray<double> vel = {dist_vel_x(rd), dist_vel_y(rd)};
+  mt::Vec2 vel = {dist_vel_x(rd), dist_vel_y(rd)};
   predators.push_back(pr::Predator{pos, vel, pred_ang, pred_ds, pred_s,
                                    pred_space, pred_range, pred_hunger});
 }
@@ -172,88 +180,64 @@ std::vector<pr::Predator> pr::get_vector_neighbours(
     std::vector<pr::Predator> const& full_vec,
     std::vector<pr::Predator>::iterator it, double dist) {
   std::vector<pr::Predator> neighbours;
-  assert(it >= full_vec.begin() && it <= full_vec.end());
-
-  // With the condition that the vector is sorted, it checks predators to the
-  // right and to the left, untile the distance on x_axis becomes larger that
-  // dist This way allows not to check the whole vector to find neighbours, but
-  // just the closest ones
-
-  if (it >= full_vec.begin() && it < full_vec.end()) {
-    auto et = it;
-    for (; et != full_vec.end(); ++et) {
-      // If the distance on x axis is larger than dist, it breaks the loop
-      if (std::abs(it->get_pos()[0] - et->get_pos()[0]) > dist) break;
-      // If not, it checks wheter the predator can be considered a neighbour and
-      // pushes it back into neighbours
-      if (boid_dist(*et, *it) < dist && boid_dist(*et, *it) > 0. &&
-          is_visible(*et, *it) == true) {
-        neighbours.push_back(*et);
-      }
-    }
-    et = it;
-    for (; et != full_vec.begin(); --et) {
-      // If the distance on x axis is larger than dist, it breaks the loop
-      if (std::abs(it->get_pos()[0] - et->get_pos()[0]) > dist) break;
-
-      // If not, it checks wheter the predator can be considered a neighbour and
-      // pushes it back into neighbours
-      if (boid_dist(*et, *it) < dist && boid_dist(*et, *it) > 0. &&
-          is_visible(*et, *it) == true) {
-        neighbours.push_back(*et);
-      }
-    }
-    // Checks wheter .begin is a neighbour or not
-    if (boid_dist(*et, *it) < dist && boid_dist(*et, *it) > 0. &&
-        is_visible(*et, *it) == true) {
-      neighbours.push_back(*et);
-    }
-  }
+  // With the condition that the vector is sorted, it checks just the closest
+  // predators on x axis
+  bd::for_each_neighbour(full_vec, it, dist,
+                         [&neighbours](pr::Predator const& pred) {
+                           neighbours.push_back(pred);
+                         });
   return neighbours;
 }
 
-// Updates state of all predators
-void pr::update_predators_state(
-    std::vector<pr::Predator>& predators, double delta_t, bool bhv,
+pr::PreyBuckets pr::bucket_preys(
     std::vector<std::pair<bd::Boid, int>> const& preys,
-    std::vector<ob::Obstacle> const& obstacles) {
-  std::vector<pr::Predator> copy_predators = predators;
-  bool predation = (preys.size() > 0);
-  for (auto idx = predators.begin(); idx != predators.end(); ++idx) {
-    std::valarray<double> pred_separation = {0., 0.};
-
-    // For each predator, it does:
-    for (auto neighbour_pred : pr::get_vector_neighbours(
-             copy_predators, copy_predators.begin() + (idx - predators.begin()),
-             idx->get_par_ds())) {
-      // apply separation from others
-      pred_separation -=
-          3 * idx->get_par_s() * (neighbour_pred.get_pos() - idx->get_pos());
-    }
-    // If at least one predator has at least one prey
-    if (predation) {
-      // Checks wheter a prey is its, and, in case, add to its "own_preys"
-      std::vector<bd::Boid> own_preys;
-      for (auto prey : preys)
-        if (prey.second == static_cast<int>(idx - predators.begin()))
-          own_preys.push_back(prey.first);
-
-      // Updates states of predator with vel correction due to obstacles, preys
-      // and borders (param bhr tells wheter to apply periodic conditions or
-      // border repulsion)
-      idx->update_state(
-          delta_t,
-          pred_separation + idx->predate(own_preys) + idx->avoid_obs(obstacles),
-          bhv);
-    } else {
-      // If no predator as a preys, it simply applies update state with obstacle
-      // and neighbourss
-      idx->update_state(delta_t, pred_separation + idx->avoid_obs(obstacles),
-                        bhv);
-    }
+    std::size_t n_predators) {
+  // Counting sort on the predator index
+  PreyBuckets buckets{std::vector<std::size_t>(n_predators + 1, 0), {}};
+  for (auto const& prey : preys) {
+    assert(prey.second >= 0 &&
+           static_cast<std::size_t>(prey.second) < n_predators);
+    ++buckets.start[static_cast<std::size_t>(prey.second) + 1];
+  }
+  for (std::size_t p = 1; p < buckets.start.size(); ++p) {
+    buckets.start[p] += buckets.start[p - 1];
   }
+  buckets.boids.resize(preys.size());
+  std::vector<std::size_t> next(buckets.start.begin(),
+                                buckets.start.end() - 1);
+  for (auto const& prey : preys) {
+    buckets.boids[next[static_cast<std::size_t>(prey.second)]++] = prey.first;
+  }
+  return buckets;
+}
+
+// Calls update(pred, copy, it, first, last) for each predator in parallel:
+// copy holds the predators before the update, it points to pred in copy and
+// [first, last) are its preys. Then it sorts predators
+template <typename F>
+static void update_each(std::vector<pr::Predator>& predators,
+                        std::vector<std::pair<bd::Boid, int>> const& preys,
+                        F update) {
+  TR_SPAN("update predators");
+  std::vector<pr::Predator> const copy_predators = predators;
+  pr::PreyBuckets buckets;
+  {
+    TR_SPAN("prey buckets");
+    buckets = pr::bucket_preys(preys, predators.size());
+  }
+
+  std::vector<std::size_t> indexes(predators.size());
+  std::iota(indexes.begin(), indexes.end(), std::size_t{0});
+  std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+                [&](std::size_t i) {
+                  TR_SPAN("predator integration");
+                  auto offset = static_cast<std::ptrdiff_t>(i);
+                  update(predators[i], copy_predators,
+                         copy_predators.begin() + offset,
+                         buckets.boids.data() + buckets.start[i],
+                         buckets.boids.data() + buckets.start[i + 1]);
+                });
 
-  // Sorts predators
   auto sort_pred = [](pr::Predator const& pred1, pr::Predator const& pred2) {
     if (pred1.get_pos()[0] == pred2.get_pos()[0]) {
       return pred1.get_pos()[1] < pred2.get_pos()[1];
@@ -262,7 +246,42 @@ void pr::update_predators_state(
     }
   };
 
-  std::sort(predators.begin(), predators.end(), sort_pred);
+  // Predators were sorted in the previous step
+  TR_SPAN("predator sort");
+  mt::incremental_sort(predators.begin(), predators.end(), sort_pred,
+                       4 * predators.size() + 64);
+}
+
+// Updates state of all predators
+void pr::update_predators_state(
+    std::vector<pr::Predator>& predators, double delta_t, bool bhv,
+    std::vector<std::pair<bd::Boid, int>> const& preys,
+    std::vector<ob::Obstacle> const& obstacles) {
+  update_each(predators, preys,
+              [&](pr::Predator& pred,
+                  std::vector<pr::Predator> const& copy_predators,
+                  std::vector<pr::Predator>::const_iterator it,
+                  bd::Boid const* first, bd::Boid const* last) {
+                mt::Vec2 pred_separation = {0., 0.};
+
+                // For each predator, it does:
+                bd::for_each_neighbour(
+                    copy_predators, it, pred.get_par_ds(),
+                    [&](pr::Predator const& neighbour_pred) {
+                      // apply separation from others
+                      pred_separation -=
+                          3 * pred.get_par_s() *
+                          (neighbour_pred.get_pos() - pred.get_pos());
+                    });
+
+                // Updates states of predator with vel correction due to
+                // obstacles, its preys and borders (param bhr tells wheter to
+                // apply periodic conditions or border repulsion)
+                pred.update_state(delta_t,
+                                  pred_separation + pred.predate(first, last) +
+                                      pred.avoid_obs(obstacles),
+                                  bhv);
+              });
 }
 
 // The same as previous function, but with parameters to be passed to
@@ -273,46 +292,24 @@ void pr::update_predators_state(
     std::vector<ob::Obstacle> const& obstacles, double pred_pred_repulsion,
     double pred_obs_detection, double pred_obstacle_separation,
     double pred_brd_detection, double pred_brd_repulsion) {
-  std::vector<pr::Predator> copy_predators = predators;
-  bool predation = (preys.size() > 0);
-  for (auto idx = predators.begin(); idx != predators.end(); ++idx) {
-    std::valarray<double> pred_separation = {0., 0.};
-
-    for (auto neighbour_pred : pr::get_vector_neighbours(
-             copy_predators, copy_predators.begin() + (idx - predators.begin()),
-             idx->get_par_ds())) {
-      pred_separation -= pred_pred_repulsion * idx->get_par_s() *
-                         (neighbour_pred.get_pos() - idx->get_pos());
-    }
-
-    if (predation) {
-      std::vector<bd::Boid> own_preys;
-      for (auto prey : preys) {
-        if (prey.second == static_cast<int>(idx - predators.begin()))
-          own_preys.push_back(prey.first);
-      }
-
-      idx->update_state(delta_t,
-                        pred_separation + idx->predate(own_preys) +
-                            idx->avoid_obs(obstacles, pred_obs_detection,
-                                           pred_obstacle_separation),
-                        bhv, pred_brd_detection, pred_brd_repulsion);
-    } else {
-      idx->update_state(
-          delta_t,
-          pred_separation + idx->avoid_obs(obstacles, pred_obs_detection,
-                                           pred_obstacle_separation),
-          bhv, pred_brd_detection, pred_brd_repulsion);
-    }
-  }
-
-  auto sort_pred = [](pr::Predator const& pred1, pr::Predator const& pred2) {
-    if (pred1.get_pos()[0] == pred2.get_pos()[0]) {
-      return pred1.get_pos()[1] < pred2.get_pos()[1];
-    } else {
-      return pred1.get_pos()[0] < pred2.get_pos()[0];
-    }
-  };
-
-  std::sort(predators.begin(), predators.end(), sort_pred);
+  update_each(
+      predators, preys,
+      [&](pr::Predator& pred, std::vector<pr::Predator> const& copy_predators,
+          std::vector<pr::Predator>::const_iterator it, bd::Boid const* first,
+          bd::Boid const* last) {
+        mt::Vec2 pred_separation = {0., 0.};
+
+        bd::for_each_neighbour(
+            copy_predators, it, pred.get_par_ds(),
+            [&](pr::Predator const& neighbour_pred) {
+              pred_separation -= pred_pred_repulsion * pred.get_par_s() *
+                                 (neighbour_pred.get_pos() - pred.get_pos());
+            });
+
+        pred.update_state(delta_t,
+                          pred_separation + pred.predate(first, last) +
+                              pred.avoid_obs(obstacles, pred_obs_detection,
+                                             pred_obstacle_separation),
+                          bhv, pred_brd_detection, pred_brd_repulsion);
+      });
 }
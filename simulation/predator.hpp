@@ -1,6 +1,7 @@
 #ifndef PREDATOR_HPP
 #define PREDATOR_HPP
 
+#include <utility>
 #include <vector>
 
 #include "boid.hpp"
@@ -11,8 +12,8 @@ class Predator : public bd::Boid {
   double p_hunger;  // fattore di coesione verso com locale prede
 
  public:
-  Predator(std::valarray<double> const&, std::valarray<double> const&, double,
-           double, double, std::valarray<double> const&, double, double);
+  Predator(mt::Vec2 const&, mt::Vec2 const&, double, double, double,
+           mt::Vec2 const&, double, double);
   Predator(double, double, double, double, double, double, double, double,
            double, double, double);
   Predator() = default;
@@ -21,20 +22,32 @@ class Predator : public bd::Boid {
   double get_hunger() const;
 
   // It returns the vel_correction that must be applied to a predator due to its
-  // preys
-  std::valarray<double> predate(std::vector<bd::Boid>&);
+  // preys, given as a vector or as the range [first, last)
+  mt::Vec2 predate(std::vector<bd::Boid> const&) const;
+  mt::Vec2 predate(bd::Boid const*, bd::Boid const*) const;
 };
 
+// Preys grouped by predator: the preys of the p-th predator are
+// boids[start[p]], ..., boids[start[p + 1] - 1]
+struct PreyBuckets {
+  std::vector<std::size_t> start;
+  std::vector<bd::Boid> boids;
+};
+
+// Groups (prey, predator index) pairs for a number of predators, keeping the
+// order of the pairs within each group
+PreyBuckets bucket_preys(std::vector<std::pair<bd::Boid, int>> const&,
+                         std::size_t);
+
 // Generates random predators with determined view_angle, param_ds, param_s,
 // range and hunger checking they don't overlap with obstacles
 std::vector<Predator> random_predators(std::vector<ob::Obstacle> const&, int,
-                                       std::valarray<double> const&, double,
-                                       double, double, double, double);
+                                       mt::Vec2 const&, double, double, double,
+                                       double, double);
 
 // It add a new predator to the simulation
 void add_predator(std::vector<Predator>&, std::vector<ob::Obstacle> const&,
-                  std::valarray<double> const&, double, double, double, double,
-                  double);
+                  mt::Vec2 const&, double, double, double, double, double);
 
 // It returns the neighbours of a predator
 std::vector<Predator> get_vector_neighbours(std::vector<Predator> const&,
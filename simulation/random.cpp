@@ -0,0 +1,64 @@
+#include "random.hpp"
+
+#include <atomic>
+#include <random>
+
+namespace {
+std::uint64_t random_seed() {
+  std::random_device rd;
+  return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+}
+
+std::atomic<std::uint64_t>& seed() {
+  static std::atomic<std::uint64_t> seed{random_seed()};
+  return seed;
+}
+
+std::atomic<std::uint64_t> next_stream{0};
+}  // namespace
+
+// The counter holds the position in the stream (low words) and the stream
+// (high words)
+rn::Philox::Philox(std::uint64_t seed, std::uint64_t stream)
+    : p_key{static_cast<std::uint32_t>(seed),
+            static_cast<std::uint32_t>(seed >> 32)},
+      p_counter{0, 0, static_cast<std::uint32_t>(stream),
+                static_cast<std::uint32_t>(stream >> 32)},
+      p_output{},
+      p_next{4} {}
+
+rn::Philox::result_type rn::Philox::operator()() {
+  if (p_next == 4) {
+    // Ten rounds on the counter, bumping the key between them
+    std::array<std::uint32_t, 4> c = p_counter;
+    std::array<std::uint32_t, 2> k = p_key;
+    for (int round = 0; round < 10; ++round) {
+      std::uint64_t p_0 = std::uint64_t{0xD2511F53} * c[0];
+      std::uint64_t p_1 = std::uint64_t{0xCD9E8D57} * c[2];
+      c = {static_cast<std::uint32_t>(p_1 >> 32) ^ c[1] ^ k[0],
+           static_cast<std::uint32_t>(p_1),
+           static_cast<std::uint32_t>(p_0 >> 32) ^ c[3] ^ k[1],
+           static_cast<std::uint32_t>(p_0)};
+      k[0] += 0x9E3779B9;
+      k[1] += 0xBB67AE85;
+    }
+    p_output = c;
+    p_next = 0;
+    // Moves to the next block of the stream
+    if (++p_counter[0] == 0) ++p_counter[1];
+  }
+  return p_output[p_next++];
+}
+
+void rn::set_seed(std::uint64_t value) {
+  seed() = value;
+  next_stream = 0;
+}
+
+std::uint64_t rn::get_seed() { return seed(); }
+
+std::uint64_t rn::reserve(std::uint64_t n) { return next_stream.fetch_add(n); }
+
+rn::Philox rn::engine() { return Philox{seed(), reserve(1)}; }
+
+rn::Philox rn::engine(std::uint64_t stream) { return Philox{seed(), stream}; }
@@ -0,0 +1,45 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace rn {
+// Counter-based generator (Philox4x32-10). Its output only depends on the
+// key (the seed) and on the counter (stream and position in it), so that
+// engines of different streams can be used by different threads without
+// sharing any state
+class Philox {
+  std::array<std::uint32_t, 2> p_key;
+  std::array<std::uint32_t, 4> p_counter;
+  std::array<std::uint32_t, 4> p_output;
+  std::size_t p_next;
+
+ public:
+  using result_type = std::uint32_t;
+
+  // Takes: seed, stream
+  Philox(std::uint64_t, std::uint64_t);
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT32_MAX; }
+  result_type operator()();
+};
+
+// Simulation-wide seed. Until it is set, it is drawn once from
+// std::random_device. Setting it restarts the streams
+void set_seed(std::uint64_t);
+std::uint64_t get_seed();
+
+// Reserves n consecutive streams and returns the first one. For a given seed,
+// the same sequence of calls always gets the same streams
+std::uint64_t reserve(std::uint64_t);
+
+// Engine of the next stream
+Philox engine();
+// Engine of a given stream
+Philox engine(std::uint64_t);
+}  // namespace rn
+
+#endif
@@ -0,0 +1,108 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace {
+// Buffers of all the threads that recorded events. They are shared with the
+// threads, so they outlive them
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<tr::Buffer>> buffers;
+};
+
+Registry& registry() {
+  static Registry registry;
+  return registry;
+}
+
+// The registry is locked only the first time a thread records an event
+tr::Buffer& thread_buffer() {
+  thread_local std::shared_ptr<tr::Buffer> buffer = [] {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto created = std::make_shared<tr::Buffer>(
+        static_cast<std::uint32_t>(reg.buffers.size()));
+    reg.buffers.push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+std::chrono::steady_clock::time_point const start_time =
+    std::chrono::steady_clock::now();
+}  // namespace
+
+tr::Buffer::Buffer(std::uint32_t thread) : b_events{}, b_thread{thread} {}
+
+void tr::Buffer::push(Event const& event) {
+  std::size_t head = b_head.load(std::memory_order_relaxed);
+  b_events[head % buffer_capacity] = event;
+  b_events[head % buffer_capacity].thread = b_thread;
+  b_head.store(head + 1, std::memory_order_release);
+}
+
+void tr::Buffer::copy_to(std::vector<Event>& events) const {
+  std::size_t head = b_head.load(std::memory_order_acquire);
+  std::size_t first = (head > buffer_capacity) ? head - buffer_capacity : 0;
+  for (std::size_t i = first; i < head; ++i) {
+    events.push_back(b_events[i % buffer_capacity]);
+  }
+}
+
+void tr::Buffer::clear() { b_head.store(0, std::memory_order_release); }
+
+std::int64_t tr::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start_time)
+      .count();
+}
+
+void tr::record(char const* name, std::int64_t start, std::int64_t end) {
+  thread_buffer().push(Event{name, 0, start, end - start});
+}
+
+// Events are sorted by start time, so that they read as a timeline
+std::vector<tr::Event> tr::collect() {
+  std::vector<Event> events;
+  auto& reg = registry();
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto const& buffer : reg.buffers) buffer->copy_to(events);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](Event const& e1, Event const& e2) {
+                     return e1.start < e2.start;
+                   });
+  return events;
+}
+
+void tr::clear() {
+  auto& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (auto const& buffer : reg.buffers) buffer->clear();
+}
+
+// Complete events ("ph": "X") with times in microseconds
+void tr::write_chrome(std::ostream& out) {
+  auto const events = collect();
+  auto const flags = out.flags();
+  auto const precision = out.precision();
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  char const* separator = "\n";
+  for (auto const& event : events) {
+    out << separator << "{\"name\": \"" << event.name
+        << "\", \"cat\": \"boids\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+        << event.thread
+        << ", \"ts\": " << static_cast<double>(event.start) / 1000.
+        << ", \"dur\": " << static_cast<double>(event.duration) / 1000.
+        << '}';
+    separator = ",\n";
+  }
+  out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace tr {
+// A timed stage of the simulation: name (a string literal), thread, start
+// and duration in nanoseconds from the start of the programme
+struct Event {
+  char const* name;
+  std::uint32_t thread;
+  std::int64_t start;
+  std::int64_t duration;
+};
+
+// Events kept for each thread, 128 kB: older ones are overwritten
+constexpr std::size_t buffer_capacity = std::size_t{1} << 12;
+
+// Ring buffer written only by its own thread, so that recording an event
+// needs no lock. It is read when the threads are idle, e.g. between steps
+class Buffer {
+  std::array<Event, buffer_capacity> b_events;
+  std::atomic<std::size_t> b_head{0};
+  std::uint32_t b_thread;
+
+ public:
+  explicit Buffer(std::uint32_t);
+  void push(Event const&);
+  // Events in the buffer, from the oldest
+  void copy_to(std::vector<Event>&) const;
+  void clear();
+};
+
+// Nanoseconds from the start of the programme
+std::int64_t now();
+
+// Records an event in the buffer of the calling thread
+void record(char const*, std::int64_t, std::int64_t);
+
+// Events of all the threads, and removal of all of them. To be called while
+// no span is being recorded
+std::vector<Event> collect();
+void clear();
+
+// Writes the events in the Chrome trace-event format, which can be opened in
+// chrome://tracing or in Perfetto
+void write_chrome(std::ostream&);
+
+// Records the time between its construction and its destruction
+class Span {
+  char const* s_name;
+  std::int64_t s_start;
+
+ public:
+  explicit Span(char const* name) : s_name{name}, s_start{now()} {}
+  ~Span() { record(s_name, s_start, now()); }
+  Span(Span const&) = delete;
+  Span& operator=(Span const&) = delete;
+};
+}  // namespace tr
+
+// TR_SPAN("name") times the rest of the enclosing scope. Spans are compiled
+// only with BOIDS_TRACE defined (cmake -DBOIDS_TRACE=ON), otherwise they
+// cost nothing
+#define TR_CONCAT_IMPL(a, b) a##b
+#define TR_CONCAT(a, b) TR_CONCAT_IMPL(a, b)
+#ifdef BOIDS_TRACE
+#define TR_SPAN(name) tr::Span const TR_CONCAT(tr_span_, __LINE__)(name)
+namespace tr {
+constexpr bool enabled = true;
+}
+#else
+#define TR_SPAN(name) static_cast<void>(0)
+namespace tr {
+constexpr bool enabled = false;
+}
+#endif
+
+#endif
@@ -7,11 +7,11 @@
 TEST_CASE(
     "Testing the Boid::update_state method without any conditions on border") {
   SUBCASE("Testing the Boid::update_state method with positive values") {
-    std::valarray<double> pos{2., 2.};
-    std::valarray<double> vel{2., 2.};
-    std::valarray<double> window{1920, 1080};
+    mt::Vec2 pos{2., 2.};
+    mt::Vec2 vel{2., 2.};
+    mt::Vec2 window{1920, 1080};
     double view_angle = 120.;
-    std::valarray<double> delta_vel{1., 1.};
+    mt::Vec2 delta_vel{1., 1.};
 
     bd::Boid boid(pos, vel, view_angle, window, 4, 1);
     boid.update_state(1., delta_vel);
@@ -25,11 +25,11 @@ TEST_CASE(
 
   SUBCASE(
       "Testing the Boid::update_state method with null vel_coorection values") {
-    std::valarray<double> pos{2., 2.};
-    std::valarray<double> vel{1., 1.};
-    std::valarray<double> window{1920, 1080};
+    mt::Vec2 pos{2., 2.};
+    mt::Vec2 vel{1., 1.};
+    mt::Vec2 window{1920, 1080};
     double view_angle = 120.;
-    std::valarray<double> delta_vel{0., 0.};
+    mt::Vec2 delta_vel{0., 0.};
 
     bd::Boid boid(pos, vel, view_angle, window, 4, 1);
     boid.update_state(1., delta_vel);
@@ -44,11 +44,11 @@ TEST_CASE(
   SUBCASE(
       "Testing the Boid::update_state method with negative values "
       "vel_correction values") {
-    std::valarray<double> pos{3., 10.};
-    std::valarray<double> vel{5., -4.};
-    std::valarray<double> window{1920, 1080};
+    mt::Vec2 pos{3., 10.};
+    mt::Vec2 vel{5., -4.};
+    mt::Vec2 window{1920, 1080};
     double view_angle = 120.;
-    std::valarray<double> delta_vel{0., -1.};
+    mt::Vec2 delta_vel{0., -1.};
 
     bd::Boid boid(pos, vel, view_angle, window, 4, 1);
     boid.update_state(1., delta_vel);
@@ -66,10 +66,10 @@ TEST_CASE("Testing the Boid::update_state method with borders") {
   // param_s
   // update_state takes: delta_t, delta_vel {vx, vy}, bhv, border_detection,
   // border_repulsion
-  void update_state(double, std::valarray<double>, bool, double, double);
+  void update_state(double, mt::Vec2, bool, double, double);
   SUBCASE("Testing the update_state with left border") {
     bd::Boid bd({20., 700.}, {-5., 70.}, 120., {1080., 1080.}, 5., 4.);
-    std::valarray<double> vel_corr{0., 0.};
+    mt::Vec2 vel_corr{0., 0.};
 
     bd.update_state(1., vel_corr, false, 1., 1.);
     CHECK(bd.get_pos()[0] == 15.);
@@ -82,7 +82,7 @@ TEST_CASE("Testing the Boid::update_state method with borders") {
       "Testing the update_state with borders on the edge of border detecion "
       "area (expected no correction)") {
     bd::Boid bd({40., 700.}, {-7., 80.}, 120., {1080., 1080.}, 5., 4.);
-    std::valarray<double> vel_corr{2., -1.};
+    mt::Vec2 vel_corr{2., -1.};
 
     bd.update_state(1., vel_corr, false, 1., 1.);
     CHECK(bd.get_pos()[0] == 35.);
@@ -93,7 +93,7 @@ TEST_CASE("Testing the Boid::update_state method with borders") {
 
   SUBCASE("Testing the update_state with right border ") {
     bd::Boid bd({1045., 700.}, {5., 76.}, 120., {1080., 1080.}, 5., 4.);
-    std::valarray<double> vel_corr{2., -4.};
+    mt::Vec2 vel_corr{2., -4.};
 
     bd.update_state(1., vel_corr, false, 2., 1.);
     CHECK(bd.get_pos()[0] == 1052.);
@@ -104,7 +104,7 @@ TEST_CASE("Testing the Boid::update_state method with borders") {
 
   SUBCASE("Testing the update_state with top border ") {
     bd::Boid bd({600., 40.}, {75., 6.}, 120., {1080., 1080.}, 5., 4.);
-    std::valarray<double> vel_corr{-4., -4.};
+    mt::Vec2 vel_corr{-4., -4.};
 
     bd.update_state(1., vel_corr, false, 3., 1.);
     CHECK(bd.get_pos()[0] == 671.);
@@ -115,7 +115,7 @@ TEST_CASE("Testing the Boid::update_state method with borders") {
 
   SUBCASE("Testing the update_state with bottom border ") {
     bd::Boid bd({100., 1040.}, {75., 6.}, 120., {1920., 1080.}, 5., 4.);
-    std::valarray<double> vel_corr{-4., -4.};
+    mt::Vec2 vel_corr{-4., -4.};
 
     bd.update_state(1., vel_corr, false, 3., 1.);
     CHECK(bd.get_pos()[0] == 171.);
@@ -130,7 +130,7 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   // Pos {x,y}, Vel{x,y}, view_angle, window_space{1920, 1080}, param_ds_,
   // param_s
 
-  // update_state(double delta_t, std::valarray<double> delta_vel, bool const&
+  // update_state(double delta_t, mt::Vec2 delta_vel, bool const&
   // brd_bhv, double param_d, double repulsion_factor)
 
   // REMEMBER: Max speed: 350; Min speed: 70; ( sqrt((vel_x)^2+(vel_y)^2) )
@@ -138,10 +138,10 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   SUBCASE(
       "Testing the Boid::update_state method with periodic conditions on left "
       "border") {
-    std::valarray<double> space{1920., 1080.};
-    std::valarray<double> init_pos{100., 100.};
-    std::valarray<double> init_vel{-75., 75.};
-    std::valarray<double> delta_vel{-30., +4.};
+    mt::Vec2 space{1920., 1080.};
+    mt::Vec2 init_pos{100., 100.};
+    mt::Vec2 init_vel{-75., 75.};
+    mt::Vec2 delta_vel{-30., +4.};
     bd::Boid bd(init_pos, init_vel, 120., space, 4., 1.);
     bd.update_state(1., delta_vel, true);
 
@@ -154,10 +154,10 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   SUBCASE(
       "Testing the Boid::update_state method with periodic conditions on right "
       "border") {
-    std::valarray<double> space{1920., 1080.};
-    std::valarray<double> init_pos{1880., 100.};
-    std::valarray<double> init_vel{75., 75.};
-    std::valarray<double> delta_vel{30., +4.};
+    mt::Vec2 space{1920., 1080.};
+    mt::Vec2 init_pos{1880., 100.};
+    mt::Vec2 init_vel{75., 75.};
+    mt::Vec2 delta_vel{30., +4.};
     bd::Boid bd(init_pos, init_vel, 120., space, 4., 1.);
     bd.update_state(1., delta_vel, true);
 
@@ -170,10 +170,10 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   SUBCASE(
       "Testing the Boid::update_state method with periodic conditions on top "
       "border") {
-    std::valarray<double> space{1920., 1080.};
-    std::valarray<double> init_pos{500., 25.};
-    std::valarray<double> init_vel{100., 7.};
-    std::valarray<double> delta_vel{30., -15.};
+    mt::Vec2 space{1920., 1080.};
+    mt::Vec2 init_pos{500., 25.};
+    mt::Vec2 init_vel{100., 7.};
+    mt::Vec2 delta_vel{30., -15.};
     bd::Boid bd(init_pos, init_vel, 120., space, 4., 1.);
     bd.update_state(1., delta_vel, true);
 
@@ -186,10 +186,10 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   SUBCASE(
       "Testing the Boid::update_state method with periodic conditions on "
       "bottom border") {
-    std::valarray<double> space{1920., 1080.};
-    std::valarray<double> init_pos{500., 1050.};
-    std::valarray<double> init_vel{100., 7.};
-    std::valarray<double> delta_vel{30., 15.};
+    mt::Vec2 space{1920., 1080.};
+    mt::Vec2 init_pos{500., 1050.};
+    mt::Vec2 init_vel{100., 7.};
+    mt::Vec2 delta_vel{30., 15.};
     bd::Boid bd(init_pos, init_vel, 120., space, 4., 1.);
     bd.update_state(1., delta_vel, true);
 
@@ -202,10 +202,10 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   SUBCASE(
       "Testing the Boid::update_state method with periodic conditions on top "
       "left corner") {
-    std::valarray<double> space{1920., 1080.};
-    std::valarray<double> init_pos{1880., 100.};
-    std::valarray<double> init_vel{20., -70.};
-    std::valarray<double> delta_vel{30., -15.};
+    mt::Vec2 space{1920., 1080.};
+    mt::Vec2 init_pos{1880., 100.};
+    mt::Vec2 init_vel{20., -70.};
+    mt::Vec2 delta_vel{30., -15.};
     bd::Boid bd(init_pos, init_vel, 120., space, 4., 1.);
     bd.update_state(1., delta_vel, true);
 
@@ -218,10 +218,10 @@ TEST_CASE("Testing the Boid::update_state method with periodic conditions") {
   SUBCASE(
       "Testing the Boid::update_state method with periodic conditions: boid "
       "exactly on top left corner, no correction needed") {
-    std::valarray<double> space{1920., 1080.};
-    std::valarray<double> init_pos{1880., 100.};
-    std::valarray<double> init_vel{20., -70.};
-    std::valarray<double> delta_vel{0., -10.};
+    mt::Vec2 space{1920., 1080.};
+    mt::Vec2 init_pos{1880., 100.};
+    mt::Vec2 init_vel{20., -70.};
+    mt::Vec2 delta_vel{0., -10.};
     bd::Boid bd(init_pos, init_vel, 120., space, 4., 1.);
     bd.update_state(1., delta_vel, true);
 
@@ -318,6 +318,32 @@ TEST_CASE("Testing the Boid::avoid_obs method") {
     CHECK(delta_vel[0] == 0);
     CHECK(delta_vel[1] == 0.75);
   }
+
+  SUBCASE("Testing the Boid::avoid_obs with a visible obstacle above") {
+    bd::Boid bd(8., 2., 0., 2., 120., 1920., 1080., 5., 1.);
+    std::vector<ob::Obstacle> obstacles{ob::Obstacle(8., 6., 1.)};
+
+    auto delta_vel = bd.avoid_obs(obstacles, 1., 1.5);
+
+    CHECK(delta_vel[0] == 0);
+    CHECK(delta_vel[1] == -0.75);
+  }
+
+  SUBCASE("Testing the Boid::avoid_obs with an ObstacleGrid") {
+    std::vector<ob::Obstacle> obstacles{
+        ob::Obstacle(40., 40., 10.), ob::Obstacle(90., 60., 20.),
+        ob::Obstacle(60., 110., 5.), ob::Obstacle(400., 300., 30.)};
+    ob::ObstacleGrid grid;
+    grid.update(obstacles, {1920., 1080.});
+
+    for (double x = 20.; x < 140.; x += 15.) {
+      bd::Boid bd(x, 75., 3., -4., 120., 1920., 1080., 10., 1.);
+      auto from_vector = bd.avoid_obs(obstacles, 2.7, 1.9);
+      auto from_grid = bd.avoid_obs(grid);
+      CHECK(from_grid[0] == doctest::Approx(from_vector[0]));
+      CHECK(from_grid[1] == doctest::Approx(from_vector[1]));
+    }
+  }
 }
 
 TEST_CASE("Testing the get_vector_neighbours function") {
@@ -414,6 +440,28 @@ TEST_CASE("Testing the get_vector_neighbours function") {
     CHECK(neighbours2[0].get_pos()[1] == 16.);
     CHECK(neighbours3.size() == 0);
   }
+
+  SUBCASE("Testing the for_each_neighbour function with three boids") {
+    std::vector<bd::Boid> boids{
+        bd::Boid({15., 10.}, {-4., 0.}, 90., {1920., 1080}, 4., 2.),
+        bd::Boid({17., 10}, {0., -3.}, 90., {1920., 1080}, 4., 2.),
+        bd::Boid({20., 10.}, {4., 0.}, 90., {1920., 1080.}, 4., 2.)};
+
+    std::vector<double> x_neighbours;
+    bd::for_each_neighbour(boids, boids.begin() + 1, 6.,
+                           [&x_neighbours](bd::Boid const& bd) {
+                             x_neighbours.push_back(bd.get_pos()[0]);
+                           });
+
+    CHECK(x_neighbours.size() == 2);
+    CHECK(x_neighbours[0] == 20.);
+    CHECK(x_neighbours[1] == 15.);
+
+    int calls{0};
+    bd::for_each_neighbour(boids, boids.cend(), 6.,
+                           [&calls](bd::Boid const&) { ++calls; });
+    CHECK(calls == 0);
+  }
 }
 
 TEST_CASE("Testing the is_visible function") {
@@ -424,7 +472,7 @@ TEST_CASE("Testing the is_visible function") {
   // The first boid passed is the one which we want to know whether or not is
   // visible BY the second boid passed
 
-  std::valarray<double> space{1920., 1080.};
+  mt::Vec2 space{1920., 1080.};
 
   SUBCASE("Testing the is_visible function with view_angle 0") {
     bd::Boid b1({1., 2.}, {2., 1.}, 0., space, 4, 1);
@@ -541,6 +589,45 @@ TEST_CASE("Testing the is_visible function") {
     CHECK(iv12 == true);
     CHECK(iv21 == true);
   }
+
+  SUBCASE("Testing that heading and angle based checks agree") {
+    bd::Boid bd1({10., 10.}, {3., -4.}, 110., space, 5., 1.);
+    std::vector<mt::Vec2> targets{{12., 10.}, {10., 14.}, {7., 6.},
+                                  {10., 7.},  {6., 10.},  {13., 13.}};
+
+    CHECK(bd1.get_heading().x == doctest::Approx(0.6));
+    CHECK(bd1.get_heading().y == doctest::Approx(-0.8));
+    for (auto const& target : targets) {
+      mt::Vec2 rel = target - bd1.get_pos();
+      CHECK(bd::in_view(rel.x, rel.y, bd1.get_heading(), bd1.get_cos_view()) ==
+            bd::is_visible(rel, bd1.get_angle(), bd1.get_view_angle()));
+    }
+  }
+}
+
+TEST_CASE("Testing the view_cosine function") {
+  CHECK(bd::view_cosine(0.) == doctest::Approx(1.));
+  CHECK(bd::view_cosine(60.) == doctest::Approx(0.5));
+
+  // Whether a unit vector at the given angle (degrees) from the heading lies
+  // in the view cone
+  auto seen = [](double view_angle, double angle) {
+    double rad = angle / 180. * M_PI;
+    return bd::in_view(std::cos(rad), std::sin(rad), {1., 0.},
+                       bd::view_cosine(view_angle));
+  };
+  CHECK(seen(0., 0.));
+  CHECK(!seen(0., 0.1));
+  CHECK(seen(60., 59.9));
+  CHECK(seen(60., -60.));
+  CHECK(!seen(60., 60.1));
+  CHECK(seen(90., 89.9));
+  CHECK(!seen(90., 90.1));
+  CHECK(seen(179., 178.9));
+  CHECK(!seen(179., 179.1));
+  // A full view sees every direction, straight behind too
+  CHECK(seen(180., 180.));
+  CHECK(seen(180., -179.9));
 }
 
 TEST_CASE("Testing the is_obs_visible") {
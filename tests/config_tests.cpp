@@ -0,0 +1,65 @@
+#include <sstream>
+#include <stdexcept>
+
+#include "../doctest.h"
+#include "../simulation/config.hpp"
+
+TEST_CASE("Testing the configuration of headless runs") {
+  cf::Config config;
+
+  SUBCASE("Testing cf::read with a configuration file") {
+    std::istringstream file(
+        "# a comment\n"
+        "boids = 250\n"
+        "\n"
+        "  d_s=12.5   # trailing comment\n"
+        "periodic = true\n"
+        "seed = 42\n");
+    cf::read(config, file);
+    CHECK(config.boids == 250);
+    CHECK(config.d_s == 12.5);
+    CHECK(config.periodic == true);
+    CHECK(config.seed == 42);
+    // Other settings keep their defaults
+    CHECK(config.d == 50.);
+    CHECK_NOTHROW(cf::validate(config));
+  }
+
+  SUBCASE("Testing cf::set with invalid keys and values") {
+    CHECK_THROWS_AS(cf::set(config, "speed", "3"), std::runtime_error);
+    CHECK_THROWS_AS(cf::set(config, "boids", "many"), std::runtime_error);
+    CHECK_THROWS_AS(cf::set(config, "boids", "10x"), std::runtime_error);
+    std::istringstream file("boids 10\n");
+    CHECK_THROWS_AS(cf::read(config, file), std::runtime_error);
+  }
+
+  SUBCASE("Testing cf::from_args") {
+    char const* argv[] = {"Boids_headless", "--steps=20", "--predators=0"};
+    config = cf::from_args(3, argv);
+    CHECK(config.steps == 20);
+    CHECK(config.predators == 0);
+    CHECK_NOTHROW(cf::validate(config));
+
+    char const* wrong[] = {"Boids_headless", "steps=20"};
+    CHECK_THROWS_AS(cf::from_args(2, wrong), std::runtime_error);
+  }
+
+  SUBCASE("Testing cf::validate with settings out of range") {
+    config.d_s = 60.;
+    CHECK_THROWS_AS(cf::validate(config), std::runtime_error);
+    config.d_s = 20.;
+    config.width = 100.;
+    CHECK_THROWS_AS(cf::validate(config), std::runtime_error);
+  }
+
+  SUBCASE("Testing cf::validate with more boids than the space holds") {
+    config.boids = 100000;
+    CHECK_THROWS_AS(cf::validate(config), std::runtime_error);
+    // Fits without obstacles, but not with many of them
+    config.boids = 30000;
+    config.obstacles = 0;
+    CHECK_NOTHROW(cf::validate(config));
+    config.obstacles = 100;
+    CHECK_THROWS_AS(cf::validate(config), std::runtime_error);
+  }
+}
@@ -0,0 +1,74 @@
+#include <vector>
+
+#include "../doctest.h"
+#include "../simulation/boid.hpp"
+#include "../simulation/field.hpp"
+#include "../simulation/flock.hpp"
+#include "../simulation/obstacles.hpp"
+
+TEST_CASE("Testing the Field class") {
+  // Field::build takes: obstacles, space, lattice spacing, reach
+  std::vector<ob::Obstacle> obstacles{ob::Obstacle({100., 100.}, 20.)};
+  ob::ObstacleGrid grid;
+  grid.update(obstacles, {400., 300.});
+  df::Field field;
+  field.build(grid, {400., 300.}, 5., 60.);
+
+  SUBCASE("Testing Field::obstacles_at") {
+    df::Sample right = field.obstacles_at({150., 100.});
+    CHECK(right.dist == doctest::Approx(30.));
+    CHECK(right.grad.x == doctest::Approx(1.));
+    CHECK(right.grad.y == doctest::Approx(0.).epsilon(1e-6));
+
+    df::Sample inside = field.obstacles_at({110., 100.});
+    CHECK(inside.dist < 0.);
+
+    // Beyond the reach the field is flat
+    df::Sample far = field.obstacles_at({300., 250.});
+    CHECK(far.dist == 60.);
+    CHECK(far.grad == mt::Vec2{0., 0.});
+  }
+
+  SUBCASE("Testing Field::borders_at") {
+    df::Sample left = field.borders_at({12.5, 150.});
+    CHECK(left.dist == doctest::Approx(12.5));
+    CHECK(left.grad.x == doctest::Approx(1.));
+
+    df::Sample top = field.borders_at({200., 290.});
+    CHECK(top.dist == doctest::Approx(10.));
+    CHECK(top.grad.y == doctest::Approx(-1.));
+
+    // Positions outside the space are clamped to the lattice
+    CHECK(field.borders_at({-10., 150.}).dist == doctest::Approx(0.));
+  }
+
+  SUBCASE("Testing Boid::avoid_obs with a field") {
+    // BOID CONSTRUCTOR takes:
+    // Pos {x,y}, Vel{x,y}, view_angle, window_space, param_ds_, param_s
+    bd::Boid towards({140., 100.}, {-2., 0.}, 120., {400., 300.}, 10., 1.);
+    bd::Boid away({140., 100.}, {2., 0.}, 120., {400., 300.}, 10., 1.);
+
+    CHECK(towards.avoid_obs(field)[0] > 0.);
+    CHECK(towards.avoid_obs(field)[1] == doctest::Approx(0.));
+    CHECK(away.avoid_obs(field) == mt::Vec2{0., 0.});
+  }
+}
+
+TEST_CASE("Testing the Flock distance field mode") {
+  fk::Parameters params(40, 10, 0.4, 0.4, 0.03);
+  std::vector<ob::Obstacle> obstacles{ob::Obstacle({200., 200.}, 30.)};
+  std::vector<pr::Predator> preds;
+
+  fk::Flock flock(params, 200, 120., {400., 400.});
+  flock.set_field_cell(4.);
+  CHECK(flock.get_field_cell() == 4.);
+
+  for (int step = 0; step < 20; ++step) {
+    flock.update_global_state(0.0166, false, preds, obstacles);
+  }
+
+  CHECK(flock.size() == 200);
+  for (std::size_t i = 0; i < flock.get_state().size(); ++i) {
+    CHECK(flock.get_state().x[i] == flock.get_state().x[i]);
+  }
+}
@@ -1,3 +1,5 @@
+#include <stdexcept>
+
 #include "../doctest.h"
 #include "../simulation/boid.hpp"
 #include "../simulation/flock.hpp"
@@ -27,12 +29,16 @@ TEST_CASE("Testing the Flock::sort method") {
     flock.push_back(bd_4);
     flock.push_back(bd_3);
 
-    flock.sort();
+    CHECK(flock.sort() == 3);
 
     CHECK(flock.get_boid(1).get_pos()[0] == 0);
     CHECK(flock.get_boid(2).get_pos()[0] == 1);
     CHECK(flock.get_boid(3).get_pos()[0] == 4);
     CHECK(flock.get_boid(4).get_pos()[0] == 54);
+
+    // An already sorted flock is left as it is
+    CHECK(flock.sort() == 0);
+    CHECK(flock.get_sort_moves() == 0);
   }
 
   SUBCASE("Testing the Flock::sort method with boids with same x_position") {
@@ -76,6 +82,128 @@ TEST_CASE("Testing the Flock::sort method") {
   }
 }
 
+TEST_CASE("Testing the random Flock constructors") {
+  // FLCOK CONSTRUCTOR takes: params, number_of_boids, view_angle, space and,
+  // optionally, obstacles
+  fk::Parameters params(40, 10, 0.4, 0.4, 0.03);
+  mt::Vec2 space{300., 200.};
+
+  // Smallest distance between two boids, checked by brute force
+  auto min_dist = [](fk::FlockState const& state) {
+    double min{1e9};
+    for (std::size_t i = 0; i < state.size(); ++i) {
+      for (std::size_t j = i + 1; j < state.size(); ++j) {
+        double dx = state.x[i] - state.x[j];
+        double dy = state.y[i] - state.y[j];
+        min = std::min(min, std::sqrt(dx * dx + dy * dy));
+      }
+    }
+    return min;
+  };
+
+  SUBCASE("Testing the constructor with a dense flock") {
+    // About one boid every 5 x 5 pixels
+    fk::Flock flock(params, 1800, 120., space);
+    auto const& state = flock.get_state();
+    CHECK(state.size() == 1800);
+    CHECK(min_dist(state) >= 3.);
+    auto outside = std::count_if(
+        state.x.begin(), state.x.end(),
+        [](double x) { return x < 20. || x > 280.; });
+    outside += std::count_if(state.y.begin(), state.y.end(),
+                             [](double y) { return y < 20. || y > 180.; });
+    CHECK(outside == 0);
+  }
+
+  SUBCASE("Testing the constructor with too many boids") {
+    // At most 86 x 53 boids fit 3 pixels apart, obstacles take some more
+    CHECK_THROWS_AS(fk::Flock(params, 5000, 120., space), std::runtime_error);
+    std::vector<ob::Obstacle> obstacles{ob::Obstacle({150., 100.}, 40.)};
+    CHECK_THROWS_AS(fk::Flock(params, 4500, 120., space, obstacles),
+                    std::runtime_error);
+  }
+
+  SUBCASE("Testing the constructor with obstacles") {
+    std::vector<ob::Obstacle> obstacles{ob::Obstacle({100., 100.}, 40.),
+                                        ob::Obstacle({220., 80.}, 30.)};
+    fk::Flock flock(params, 1000, 120., space, obstacles);
+    auto const& state = flock.get_state();
+    CHECK(state.size() == 1000);
+    CHECK(min_dist(state) >= 3.);
+    int too_close{0};
+    for (std::size_t i = 0; i < state.size(); ++i) {
+      for (auto const& obs : obstacles) {
+        mt::Vec2 pos{state.x[i], state.y[i]};
+        too_close += mt::vec_norm(pos - obs.get_pos()) < obs.get_size() + 6.;
+      }
+    }
+    CHECK(too_close == 0);
+  }
+}
+
+TEST_CASE("Testing the Flock::add_boids method") {
+  fk::Parameters params(40, 10, 0.4, 0.4, 0.03);
+  mt::Vec2 space{400., 300.};
+  std::vector<ob::Obstacle> obstacles{ob::Obstacle({200., 150.}, 50.)};
+  fk::Flock flock(params, 200, 120., space, obstacles);
+
+  flock.add_boids(800, obstacles);
+  auto const& state = flock.get_state();
+  CHECK(flock.size() == 1000);
+
+  // The flock is still sorted and there are no coinciding boids
+  bool sorted{true};
+  for (std::size_t i = 1; i < state.size(); ++i) {
+    sorted = sorted && (state.x[i - 1] < state.x[i] ||
+                        (state.x[i - 1] == state.x[i] &&
+                         state.y[i - 1] < state.y[i]));
+  }
+  CHECK(sorted);
+  int too_close{0};
+  for (std::size_t i = 0; i < state.size(); ++i) {
+    mt::Vec2 pos{state.x[i], state.y[i]};
+    too_close += mt::vec_norm(pos - obstacles[0].get_pos()) < 56.;
+  }
+  CHECK(too_close == 0);
+
+  // The centre of mass is updated
+  bd::Boid com = flock.get_com();
+  flock.update_com();
+  CHECK(com.get_pos()[0] == doctest::Approx(flock.get_com().get_pos()[0]));
+  CHECK(com.get_pos()[1] == doctest::Approx(flock.get_com().get_pos()[1]));
+  CHECK(com.get_vel()[0] == doctest::Approx(flock.get_com().get_vel()[0]));
+  CHECK(com.get_vel()[1] == doctest::Approx(flock.get_com().get_vel()[1]));
+
+  // The flock is sorted even if it wasn't before: erase moves the last boid
+  // in place of the first one
+  flock.erase(flock.begin());
+  flock.add_boids(50, obstacles);
+  CHECK(flock.size() == 1049);
+  sorted = true;
+  for (std::size_t i = 1; i < state.size(); ++i) {
+    sorted = sorted && (state.x[i - 1] < state.x[i] ||
+                        (state.x[i - 1] == state.x[i] &&
+                         state.y[i - 1] < state.y[i]));
+  }
+  CHECK(sorted);
+  // The centre of mass doesn't count the erased boid
+  com = flock.get_com();
+  flock.update_com();
+  CHECK(com.get_pos()[0] == doctest::Approx(flock.get_com().get_pos()[0]));
+  CHECK(com.get_pos()[1] == doctest::Approx(flock.get_com().get_pos()[1]));
+  CHECK(com.get_vel()[0] == doctest::Approx(flock.get_com().get_vel()[0]));
+  CHECK(com.get_vel()[1] == doctest::Approx(flock.get_com().get_vel()[1]));
+
+  // Boids can be added to an empty flock too
+  fk::Flock empty(params, 0, 120., space);
+  empty.add_boids(3);
+  CHECK(empty.size() == 3);
+  CHECK(empty.get_com().get_pos()[0] ==
+        doctest::Approx((empty.get_state().x[0] + empty.get_state().x[1] +
+                         empty.get_state().x[2]) /
+                        3.));
+}
+
 TEST_CASE("Testing the Flock::update_com method") {
   // BOID CONSTRUCTOR takes:
   // Pos {x,y}, Vel{x,y}, view_angle, window_space{1920, 1080}, param_ds_,
@@ -546,7 +674,7 @@ TEST_CASE("Testing the Flock::avoid_pred method") {
   fk::Flock flock(params, 0., 120., {1920., 1080.});
   flock.push_back(bd);
   pr::Predator pd(14., 17., -2., -1, 120., 1920., 1080., 6., 4., 5., 2.);
-  std::valarray<double> delta_vel = flock.avoid_pred(bd, pd, 2., 2.);
+  mt::Vec2 delta_vel = flock.avoid_pred(bd, pd, 2., 2.);
   CHECK(delta_vel[0] == -32.);
   CHECK(delta_vel[1] == -16.);
 }
@@ -646,4 +774,236 @@ TEST_CASE("Testing the Flock::Update_stats method") {
     CHECK(flock_2.get_stats().av_vel == 0);
     CHECK(flock_2.get_stats().vel_RMS == 0);
   }
-}
\ No newline at end of file
+}
+TEST_CASE("Testing the FlockState storage") {
+  // BOID CONSTRUCTOR takes:
+  // Pos {x,y}, Vel{x,y}, view_angle, window_space{1920, 1080}, param_ds_,
+  // param_s
+
+  bd::Boid bd_1(1, 4, 5, 0, 120., 1920, 1080, 4, 1);
+  bd::Boid bd_2(3, 3, -2, 9, 120., 1920, 1080, 4, 1);
+  bd::Boid bd_3(10, 4, 0, 5, 120., 1920, 1080, 4, 1);
+
+  fk::FlockState state;
+  state.push_back(bd_1);
+  state.push_back(bd_2);
+  state.push_back(bd_3);
+
+  SUBCASE("Testing the FlockState::push_back method") {
+    CHECK(state.size() == 3);
+    CHECK(state.x[1] == 3.);
+    CHECK(state.y[1] == 3.);
+    CHECK(state.vx[1] == -2.);
+    CHECK(state.vy[1] == 9.);
+    CHECK(state.get_angle(1) == doctest::Approx(bd_2.get_angle()));
+  }
+
+  SUBCASE("Testing the FlockState::permute method") {
+    state.permute({2, 0});
+
+    CHECK(state.size() == 2);
+    CHECK(state.x[0] == 10.);
+    CHECK(state.vy[0] == 5.);
+    CHECK(state.x[1] == 1.);
+    CHECK(state.vx[1] == 5.);
+  }
+
+  SUBCASE("Testing the FlockState::erase method") {
+    state.erase(0);
+
+    CHECK(state.size() == 2);
+    CHECK(state.x[0] == 3.);
+    CHECK(state.vy.size() == 2);
+  }
+
+  SUBCASE("Testing the FlockState::resize and swap methods") {
+    fk::FlockState back;
+    back.resize(state.size());
+    back.set(0, bd_3);
+    state.swap(back);
+
+    CHECK(state.size() == 3);
+    CHECK(state.x[0] == 10.);
+    CHECK(back.x[0] == 1.);
+    back.resize(1);
+    CHECK(back.size() == 1);
+    CHECK(back.vy.size() == 1);
+  }
+
+  SUBCASE("Testing the Flock::get_state method") {
+    fk::Parameters params(4, 4, 1, 2, 3);
+    fk::Flock flock(params, 0, 120., {1920, 1080});
+
+    flock.push_back(bd_3);
+    flock.push_back(bd_1);
+    flock.sort();
+
+    CHECK(flock.get_state().size() == 2);
+    CHECK(flock.get_state().x[0] == flock.get_boid(1).get_pos()[0]);
+    CHECK(flock.get_state().vy[1] == flock.get_boid(2).get_vel()[1]);
+    CHECK(flock.get_state().get_angle(1) ==
+          doctest::Approx(flock.get_boid(2).get_angle()));
+  }
+}
+
+TEST_CASE("Testing the boid slots") {
+  bd::Boid bd_1(30, 4, 5, 0, 120., 1920, 1080, 4, 1);
+  bd::Boid bd_2(20, 3, -2, 9, 120., 1920, 1080, 4, 1);
+  bd::Boid bd_3(10, 4, 0, 5, 120., 1920, 1080, 4, 1);
+  fk::Parameters params(10, 4, 1, 2, 3);
+  fk::Flock flock(params, 0, 120., {1920, 1080});
+  flock.push_back(bd_1);
+  flock.push_back(bd_2);
+  flock.push_back(bd_3);
+
+  SUBCASE("Testing that slots follow the boids when sorting") {
+    flock.sort();
+    CHECK(flock.get_state().x[0] == 10.);
+    CHECK(flock.get_slot(0) == 2);
+    CHECK(flock.get_slot(2) == 0);
+    CHECK(flock.get_slots() == 3);
+  }
+
+  SUBCASE("Testing that released slots are reused") {
+    flock.erase(flock.begin());
+    CHECK(flock.size() == 2);
+    CHECK(!flock.is_alive(0));
+    CHECK(flock.is_alive(1));
+    // The last boid took the place of the erased one
+    CHECK(flock.get_state().x[0] == 10.);
+    CHECK(flock.get_slot(0) == 2);
+
+    flock.push_back(bd_1);
+    CHECK(flock.get_slots() == 3);
+    CHECK(flock.is_alive(0));
+    CHECK(flock.get_slot(2) == 0);
+    flock.push_back(bd_1);
+    CHECK(flock.get_slots() == 4);
+  }
+
+  SUBCASE("Testing that eaten boids release their slots") {
+    std::vector<pr::Predator> preds{pr::Predator({20., 3.}, {0., 0.}, 120.,
+                                                 20., 0.3, {1920., 1080.},
+                                                 100., 0.5)};
+    std::vector<ob::Obstacle> obstacles;
+    flock.sort();
+    flock.update_global_state(0.01, true, preds, obstacles);
+    CHECK(flock.size() == 2);
+    CHECK(flock.is_alive(0));
+    CHECK(!flock.is_alive(1));
+    CHECK(flock.is_alive(2));
+    // The survivors keep their slots, 0 and 2, in any order
+    CHECK(flock.get_slot(0) + flock.get_slot(1) == 2);
+    CHECK(flock.get_slot(0) != flock.get_slot(1));
+  }
+
+  SUBCASE("Testing the identifiers of the boids") {
+    fk::Id id_1 = flock.get_id(0);
+    fk::Id id_3 = flock.get_id(2);
+    CHECK(id_1 == 0);
+    CHECK(id_3 == 2);
+
+    // Identifiers follow the boids when sorting
+    flock.sort();
+    CHECK(flock.index_of(id_1) == 2);
+    CHECK(flock.index_of(id_3) == 0);
+    CHECK(flock.get_id(0) == id_3);
+
+    // A boid born in the slot of a dead one has a new identifier
+    flock.erase(flock.begin());
+    CHECK(flock.index_of(id_3) == flock.get_state().size());
+    CHECK(flock.index_of(id_1) == 0);
+    flock.push_back(bd_3);
+    fk::Id id_4 = flock.get_id(2);
+    CHECK(id_4 != id_3);
+    CHECK(flock.get_slot(2) == 2);
+    CHECK(flock.index_of(id_4) == 2);
+    CHECK(flock.index_of(id_3) == flock.get_state().size());
+  }
+}
+
+TEST_CASE("Testing the Flock::update_global_state method") {
+  // PREDATOR CONSTRUCTOR takes: pos, vel, view_angle, param_ds, param_s, space,
+  // range, hunger
+  fk::Parameters params(40, 10, 0.4, 0.4, 0.03);
+  std::vector<ob::Obstacle> obstacles;
+
+  SUBCASE("Testing that update_global_state does not depend on scheduling") {
+    fk::Flock flock_1(params, 500, 120., {400., 400.});
+    fk::Flock flock_2 = flock_1;
+    std::vector<pr::Predator> preds_1{
+        pr::Predator({100., 100.}, {20., 20.}, 120., 20., 0.3, {400., 400.},
+                     100., 0.5),
+        pr::Predator({300., 250.}, {-20., 10.}, 120., 20., 0.3, {400., 400.},
+                     100., 0.5)};
+    std::vector<pr::Predator> preds_2 = preds_1;
+
+    for (int step = 0; step < 3; ++step) {
+      flock_1.update_global_state(0.01, true, preds_1, obstacles);
+      flock_2.update_global_state(0.01, true, preds_2, obstacles);
+    }
+
+    CHECK(flock_1.get_state().x == flock_2.get_state().x);
+    CHECK(flock_1.get_state().vy == flock_2.get_state().vy);
+    for (std::size_t i = 0; i < preds_1.size(); ++i) {
+      CHECK(preds_1[i].get_pos() == preds_2[i].get_pos());
+      CHECK(preds_1[i].get_vel() == preds_2[i].get_vel());
+    }
+    // The predators moved towards some preys
+    CHECK(preds_1[0].get_vel() != mt::Vec2{20., 20.});
+  }
+
+  SUBCASE("Testing update_global_state with many predators") {
+    fk::Flock flock(params, 1000, 120., {400., 400.});
+    std::vector<pr::Predator> preds;
+    for (int i = 0; i < 10; ++i) {
+      for (int j = 0; j < 10; ++j) {
+        preds.push_back(pr::Predator({20. + 40. * i, 20. + 40. * j},
+                                     {10., -10.}, 120., 20., 0.3,
+                                     {400., 400.}, 30., 0.5));
+      }
+    }
+    // Boids within 0.3 * d_s from any predator are eaten
+    auto const& state = flock.get_state();
+    std::size_t alive{0};
+    for (std::size_t i = 0; i < state.size(); ++i) {
+      alive += std::none_of(preds.begin(), preds.end(),
+                            [&](pr::Predator const& pred) {
+                              double dx = pred.get_pos()[0] - state.x[i];
+                              double dy = pred.get_pos()[1] - state.y[i];
+                              return std::sqrt(dx * dx + dy * dy) < 3.;
+                            });
+    }
+    CHECK(alive < state.size());
+
+    flock.update_global_state(0.01, true, preds, obstacles);
+    CHECK(static_cast<std::size_t>(flock.size()) == alive);
+  }
+
+  SUBCASE("Testing the statistics computed by update_global_state") {
+    fk::Flock flock(params, 800, 120., {400., 400.});
+    flock.set_stats_in_update(true);
+    fk::Flock before = flock;
+    before.update_stats();
+    std::vector<pr::Predator> preds;
+
+    flock.update_global_state(0.01, true, preds, obstacles);
+    // Statistics are the ones of the state the update started from
+    CHECK(flock.get_stats().av_dist ==
+          doctest::Approx(before.get_stats().av_dist));
+    CHECK(flock.get_stats().dist_RMS ==
+          doctest::Approx(before.get_stats().dist_RMS));
+    CHECK(flock.get_stats().av_vel ==
+          doctest::Approx(before.get_stats().av_vel));
+    CHECK(flock.get_stats().vel_RMS ==
+          doctest::Approx(before.get_stats().vel_RMS));
+
+    // The centre of mass is the one of the new state
+    bd::Boid com = flock.get_com();
+    flock.update_com();
+    CHECK(com.get_pos()[0] == doctest::Approx(flock.get_com().get_pos()[0]));
+    CHECK(com.get_pos()[1] == doctest::Approx(flock.get_com().get_pos()[1]));
+    CHECK(com.get_vel()[0] == doctest::Approx(flock.get_com().get_vel()[0]));
+    CHECK(com.get_vel()[1] == doctest::Approx(flock.get_com().get_vel()[1]));
+  }
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "../doctest.h"
+#include "../simulation/flock.hpp"
+#include "../simulation/grid.hpp"
+
+TEST_CASE("Testing the Grid class") {
+  // Grid::build takes: minimum cell size, space{x,y}, x positions, y positions
+
+  SUBCASE("Testing Grid::build with a few points") {
+    gr::Grid grid;
+    std::vector<double> x{10., 110., 15., 390.};
+    std::vector<double> y{10., 10., 95., 290.};
+    grid.build(100., {400., 300.}, x, y);
+
+    CHECK(grid.get_cell_size() == 100.);
+    CHECK(grid.get_cols() == 4);
+    CHECK(grid.get_rows() == 3);
+    CHECK(grid.count(0, 0) == 2);
+    CHECK(grid.count(1, 0) == 1);
+    CHECK(grid.count(3, 2) == 1);
+    CHECK(grid.count(2, 1) == 0);
+  }
+
+  SUBCASE("Testing Grid::build with points outside the space") {
+    gr::Grid grid;
+    std::vector<double> x{-20., 450.};
+    std::vector<double> y{-5., 320.};
+    grid.build(100., {400., 300.}, x, y);
+
+    CHECK(grid.col(-20.) == 0);
+    CHECK(grid.row(320.) == 2);
+    CHECK(grid.count(0, 0) == 1);
+    CHECK(grid.count(3, 2) == 1);
+  }
+
+  SUBCASE("Testing Grid::build with a small cell size and few points") {
+    gr::Grid grid;
+    std::vector<double> x{1., 2.};
+    std::vector<double> y{1., 2.};
+    grid.build(2.5, {1920., 1080.}, x, y);
+
+    // Cells are enlarged so that their number stays limited
+    CHECK(grid.get_cell_size() > 2.5);
+    CHECK(grid.get_cols() * grid.get_rows() <= 72 + 2 * 72);
+  }
+
+  SUBCASE("Testing Grid::for_each_near") {
+    gr::Grid grid;
+    std::vector<double> x{10., 110., 250., 390., 150.};
+    std::vector<double> y{10., 10., 150., 290., 250.};
+    grid.build(100., {400., 300.}, x, y);
+
+    std::vector<std::size_t> near;
+    grid.for_each_near(50., 50., [&near](std::size_t i) { near.push_back(i); });
+    std::sort(near.begin(), near.end());
+
+    CHECK(near.size() == 2);
+    CHECK(near[0] == 0);
+    CHECK(near[1] == 1);
+
+    near.clear();
+    grid.for_each_near(250., 150.,
+                       [&near](std::size_t i) { near.push_back(i); });
+    CHECK(near.size() == 4);
+  }
+}
+
+TEST_CASE("Testing the flock neighbours found through the grid") {
+  SUBCASE("Testing Flock::get_neighbours with boids in different cells") {
+    bd::Boid bd_1(99., 50., 1., 0., 180., 1920, 1080, 4, 1);
+    bd::Boid bd_2(101., 50., 1., 0., 180., 1920, 1080, 4, 1);
+    bd::Boid bd_3(150., 50., 1., 0., 180., 1920, 1080, 4, 1);
+    bd::Boid bd_4(300., 50., 1., 0., 180., 1920, 1080, 4, 1);
+
+    fk::Parameters params(60., 4., 1., 1., 1.);
+    fk::Flock flock(params, 0, 180., {1920, 1080});
+    flock.push_back(bd_1);
+    flock.push_back(bd_2);
+    flock.push_back(bd_3);
+    flock.push_back(bd_4);
+
+    auto it = flock.begin() + 1;
+    auto neighbours = flock.get_neighbours(it);
+
+    CHECK(neighbours.size() == 2);
+    CHECK(neighbours[0].get_pos()[0] == 99.);
+    CHECK(neighbours[1].get_pos()[0] == 150.);
+  }
+
+  SUBCASE("Testing Flock::update_stats counting each couple once") {
+    bd::Boid bd_1(100., 100., 3., 4., 180., 1920, 1080, 4, 1);
+    bd::Boid bd_2(103., 104., 3., 4., 180., 1920, 1080, 4, 1);
+    bd::Boid bd_3(500., 500., 3., 4., 180., 1920, 1080, 4, 1);
+
+    fk::Parameters params(10., 4., 1., 1., 1.);
+    fk::Flock flock(params, 0, 180., {1920, 1080});
+    flock.push_back(bd_1);
+    flock.push_back(bd_2);
+    flock.push_back(bd_3);
+    flock.update_stats();
+
+    CHECK(flock.get_stats().av_dist == doctest::Approx(5.));
+    CHECK(flock.get_stats().dist_RMS == doctest::Approx(0.));
+    CHECK(flock.get_stats().av_vel == doctest::Approx(5.));
+  }
+}
@@ -0,0 +1,71 @@
+#include "../doctest.h"
+#include "../simulation/histogram.hpp"
+
+TEST_CASE("Testing the duration histogram") {
+  hs::Histogram histogram;
+
+  SUBCASE("Testing the buckets") {
+    // Exact buckets below 32 us
+    CHECK(hs::Histogram::bucket(0) == 0);
+    CHECK(hs::Histogram::bucket(31) == 31);
+    CHECK(hs::Histogram::bucket(32) == 32);
+    CHECK(hs::Histogram::bucket(64) == 64);
+    CHECK(hs::Histogram::bucket(65) == 64);
+    CHECK(hs::Histogram::bucket(66) == 65);
+    CHECK(hs::Histogram::lowest(65) == 66);
+    CHECK(hs::Histogram::width(65) == 2);
+    // Every duration lies in its bucket, whose width is at most 1 / 32 of it
+    for (std::uint64_t us : {1ull, 100ull, 16'667ull, 1'000'000ull,
+                             123'456'789ull}) {
+      auto b = hs::Histogram::bucket(us);
+      CHECK(hs::Histogram::lowest(b) <= us);
+      CHECK(us < hs::Histogram::lowest(b) + hs::Histogram::width(b));
+      CHECK(hs::Histogram::width(b) * 32 <= us + 32);
+    }
+    CHECK(hs::Histogram::bucket(~0ull) == hs::Histogram::bucket_count - 1);
+  }
+
+  SUBCASE("Testing percentiles") {
+    CHECK(histogram.percentile(50.) == 0.);
+    // 1 to 100 ms, then a spike
+    for (int ms = 1; ms <= 100; ++ms) histogram.record(ms);
+    histogram.record(500.);
+    CHECK(histogram.count() == 101);
+    CHECK(histogram.percentile(50.) == doctest::Approx(51.).epsilon(1. / 32));
+    CHECK(histogram.percentile(99.) == doctest::Approx(100.).epsilon(1. / 32));
+    CHECK(histogram.percentile(100.) == 500.);
+    CHECK(histogram.max() == 500.);
+    CHECK(histogram.mean() == doctest::Approx(5550. / 101.));
+    CHECK(histogram.percentile(0.) <= histogram.percentile(50.));
+  }
+
+  SUBCASE("Testing merge and clear") {
+    hs::Histogram other;
+    histogram.record(2.);
+    other.record(4.);
+    other.record(8.);
+    histogram.merge(other);
+    CHECK(histogram.count() == 3);
+    CHECK(histogram.max() == 8.);
+    CHECK(histogram.count(hs::Histogram::bucket(4000)) == 1);
+    histogram.clear();
+    CHECK(histogram.count() == 0);
+    CHECK(histogram.max() == 0.);
+  }
+
+  SUBCASE("Testing the rolling window") {
+    hs::Rolling window(4);
+    CHECK(window.max() == 0.);
+    window.record(100.);
+    for (int i = 0; i < 3; ++i) window.record(2.);
+    CHECK(window.count() == 4);
+    CHECK(window.max() == 100.);
+    CHECK(window.percentile(99.) == 100.);
+    // The spike leaves the window after 4 more durations
+    for (int i = 0; i < 4; ++i) window.record(3.);
+    CHECK(window.count() == 4);
+    CHECK(window.max() == 3.);
+    CHECK(window.percentile(50.) == doctest::Approx(3.).epsilon(1. / 32));
+    CHECK(window.percentile(99.) == 3.);
+  }
+}
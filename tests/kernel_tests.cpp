@@ -0,0 +1,88 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../doctest.h"
+#include "../simulation/kernel.hpp"
+
+TEST_CASE("Testing the make_query function") {
+  // make_query takes: x, y, vx, vy, cos_view, d, d_s
+
+  SUBCASE("Testing make_query with a moving boid") {
+    kn::Query q = kn::make_query(10., 20., 3., -4., 0.5, 5., 2.);
+
+    CHECK(q.hx == doctest::Approx(0.6));
+    CHECK(q.hy == doctest::Approx(-0.8));
+    CHECK(q.cos_view == 0.5);
+    CHECK(q.d2 == 25.);
+    CHECK(q.ds2 == 4.);
+  }
+
+  SUBCASE("Testing make_query with a still boid and full view") {
+    kn::Query q = kn::make_query(10., 20., 0., 0., -2., 5., 2.);
+
+    CHECK(q.hx == 0.);
+    CHECK(q.hy == 1.);
+    CHECK(q.cos_view == -2.);
+  }
+}
+
+TEST_CASE("Testing the accumulate function") {
+  SUBCASE("Testing accumulate with a few candidates") {
+    // The boid in (0, 0) moves along x and sees 120 degrees on each side
+    kn::Query q = kn::make_query(0., 0., 1., 0., -0.5, 5., 2.);
+    std::vector<double> x{0., 1., -3., 2., -4.5, 6.};
+    std::vector<double> y{0., 0., 0., 2., -0.5, 0.};
+    std::vector<double> vx{1., 2., 3., 1., 1., 1.};
+    std::vector<double> vy{0., 1., 1., -1., 0., 0.};
+    kn::Candidates c{x.data(), y.data(), vx.data(), vy.data()};
+
+    kn::Sums sums;
+    kn::accumulate(kn::Isa::scalar, q, c, 0, x.size(), sums);
+
+    // Itself, the boids behind it and the one out of range are not counted
+    CHECK(sums.count == 2.);
+    CHECK(sums.sep_x == 1.);
+    CHECK(sums.sep_y == 0.);
+    CHECK(sums.dx == 3.);
+    CHECK(sums.dy == 2.);
+    CHECK(sums.dvx == 1.);
+    CHECK(sums.dvy == 0.);
+  }
+
+  SUBCASE("Testing that every instruction set gives the scalar result") {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<> pos(0., 100.);
+    std::uniform_real_distribution<> vel(-50., 50.);
+    std::vector<double> x(203);
+    std::vector<double> y(203);
+    std::vector<double> vx(203);
+    std::vector<double> vy(203);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      x[i] = pos(gen);
+      y[i] = pos(gen);
+      vx[i] = vel(gen);
+      vy[i] = vel(gen);
+    }
+    kn::Candidates c{x.data(), y.data(), vx.data(), vy.data()};
+    double cos_view = std::cos(100. / 180. * M_PI);
+    kn::Query q = kn::make_query(50., 50., 10., 5., cos_view, 30., 10.);
+
+    kn::Sums expected;
+    kn::accumulate(kn::Isa::scalar, q, c, 1, x.size(), expected);
+    CHECK(expected.count > 0.);
+
+    for (auto isa : {kn::Isa::sse2, kn::Isa::avx2}) {
+      if (static_cast<int>(isa) > static_cast<int>(kn::best_isa())) continue;
+      kn::Sums sums;
+      kn::accumulate(isa, q, c, 1, x.size(), sums);
+      CHECK(sums.count == expected.count);
+      CHECK(sums.sep_x == doctest::Approx(expected.sep_x));
+      CHECK(sums.sep_y == doctest::Approx(expected.sep_y));
+      CHECK(sums.dx == doctest::Approx(expected.dx));
+      CHECK(sums.dy == doctest::Approx(expected.dy));
+      CHECK(sums.dvx == doctest::Approx(expected.dvx));
+      CHECK(sums.dvy == doctest::Approx(expected.dvy));
+    }
+  }
+}
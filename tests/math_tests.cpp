@@ -1,3 +1,6 @@
+#include <type_traits>
+#include <vector>
+
 #include "../doctest.h"
 #include "../simulation/boid.hpp"
 #include "../simulation/flock.hpp"
@@ -5,15 +8,15 @@
 #include "../simulation/predator.hpp"
 
 TEST_CASE("Testing vec_norm function") {
-  std::valarray<double> vec_1{1, 4};
-  std::valarray<double> vec_2{2, 5};
-  std::valarray<double> vec_3{0, 0};
-  std::valarray<double> vec_4{-1, -4};
+  mt::Vec2 vec_1{1, 4};
+  mt::Vec2 vec_2{2, 5};
+  mt::Vec2 vec_3{0, 0};
+  mt::Vec2 vec_4{-1, -4};
 
-  double norm1 = mt::vec_norm<double>(vec_1);
-  double norm2 = mt::vec_norm<double>(vec_2);
-  double norm3 = mt::vec_norm<double>(vec_3);
-  double norm4 = mt::vec_norm<double>(vec_4);
+  double norm1 = mt::vec_norm(vec_1);
+  double norm2 = mt::vec_norm(vec_2);
+  double norm3 = mt::vec_norm(vec_3);
+  double norm4 = mt::vec_norm(vec_4);
 
   CHECK(norm1 == doctest::Approx(4.1231056));
   CHECK(norm2 == doctest::Approx(5.385164807));
@@ -21,6 +24,35 @@ TEST_CASE("Testing vec_norm function") {
   CHECK(norm4 == doctest::Approx(4.1231056));
 }
 
+TEST_CASE("Testing the Vec2 struct") {
+  static_assert(std::is_trivially_copyable_v<mt::Vec2>);
+  constexpr mt::Vec2 vec_1{3., 4.};
+  constexpr mt::Vec2 vec_2{-1., 2.};
+
+  SUBCASE("Testing the Vec2 operators") {
+    static_assert((vec_1 + vec_2) == mt::Vec2{2., 6.});
+    CHECK((vec_1 - vec_2) == mt::Vec2{4., 2.});
+    CHECK((2. * vec_1) == mt::Vec2{6., 8.});
+    CHECK((vec_1 / 2.) == mt::Vec2{1.5, 2.});
+    CHECK(-vec_2 == mt::Vec2{1., -2.});
+
+    mt::Vec2 vec_3 = vec_1;
+    vec_3 -= vec_2;
+    vec_3 *= 0.5;
+    CHECK(vec_3[0] == 2.);
+    CHECK(vec_3[1] == 1.);
+  }
+
+  SUBCASE("Testing norm, dot and normalized") {
+    static_assert(vec_1.norm2() == 25.);
+    CHECK(vec_1.norm() == 5.);
+    CHECK(vec_1.dot(vec_2) == 5.);
+    CHECK(vec_1.normalized().x == doctest::Approx(0.6));
+    CHECK(vec_1.normalized().y == doctest::Approx(0.8));
+    CHECK(mt::Vec2{0., 0.}.normalized() == mt::Vec2{0., 0.});
+  }
+}
+
 TEST_CASE("Testing boid_dist function") {
   // BOID CONSTRUCTOR takes:
   // Pos {x,y}, Vel{x,y}, view_angle, window_space{1920, 1080}, param_ds_,
@@ -74,25 +106,25 @@ TEST_CASE("Testing boid_dist function") {
 }
 
 TEST_CASE("Testing the compute_angle function") {
-  std::valarray<double> vec_1{1, 4};
-  std::valarray<double> vec_2{1, -4};
-  std::valarray<double> vec_3{-1, -4};
-  std::valarray<double> vec_4{-1., -6};
-  std::valarray<double> vec_5{0., 0.};
-  std::valarray<double> vec_6{0., 6.};
-  std::valarray<double> vec_7{0., -4.};
-  std::valarray<double> vec_8{-3., 2.};
-  std::valarray<double> vec_9{4., 1};
-
-  double angle_1 = mt::compute_angle<double>(vec_1);
-  double angle_2 = mt::compute_angle<double>(vec_2);
-  double angle_3 = mt::compute_angle<double>(vec_3);
-  double angle_4 = mt::compute_angle<double>(vec_4);
-  double angle_5 = mt::compute_angle<double>(vec_5);
-  double angle_6 = mt::compute_angle<double>(vec_6);
-  double angle_7 = mt::compute_angle<double>(vec_7);
-  double angle_8 = mt::compute_angle<double>(vec_8);
-  double angle_9 = mt::compute_angle<double>(vec_9);
+  mt::Vec2 vec_1{1, 4};
+  mt::Vec2 vec_2{1, -4};
+  mt::Vec2 vec_3{-1, -4};
+  mt::Vec2 vec_4{-1., -6};
+  mt::Vec2 vec_5{0., 0.};
+  mt::Vec2 vec_6{0., 6.};
+  mt::Vec2 vec_7{0., -4.};
+  mt::Vec2 vec_8{-3., 2.};
+  mt::Vec2 vec_9{4., 1};
+
+  double angle_1 = mt::compute_angle(vec_1);
+  double angle_2 = mt::compute_angle(vec_2);
+  double angle_3 = mt::compute_angle(vec_3);
+  double angle_4 = mt::compute_angle(vec_4);
+  double angle_5 = mt::compute_angle(vec_5);
+  double angle_6 = mt::compute_angle(vec_6);
+  double angle_7 = mt::compute_angle(vec_7);
+  double angle_8 = mt::compute_angle(vec_8);
+  double angle_9 = mt::compute_angle(vec_9);
 
   CHECK(angle_1 == doctest::Approx(14.036243));
   CHECK(angle_2 == doctest::Approx(165.963756));
@@ -103,4 +135,32 @@ TEST_CASE("Testing the compute_angle function") {
   CHECK(angle_7 == 180.);
   CHECK(angle_8 == doctest::Approx(-56.30994327));
   CHECK(angle_9 == doctest::Approx(75.96375653));
+
+  CHECK(mt::compute_angle<double>(-1., -6.) == angle_4);
+  CHECK(mt::compute_angle<double>(0., -4.) == 180.);
+}
+
+TEST_CASE("Testing the incremental_sort function") {
+  auto less = [](int a, int b) { return a < b; };
+
+  SUBCASE("Testing incremental_sort with an almost sorted vector") {
+    std::vector<int> vec{1, 3, 2, 4, 6, 5, 7};
+
+    CHECK(mt::incremental_sort(vec.begin(), vec.end(), less, 10) == 2);
+    CHECK(vec == std::vector<int>{1, 2, 3, 4, 5, 6, 7});
+    CHECK(mt::incremental_sort(vec.begin(), vec.end(), less, 10) == 0);
+  }
+
+  SUBCASE("Testing incremental_sort falling back to a full sort") {
+    std::vector<int> vec{9, 8, 7, 6, 5, 4, 3, 2, 1};
+
+    CHECK(mt::incremental_sort(vec.begin(), vec.end(), less, 3) > 3);
+    CHECK(vec == std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9});
+  }
+
+  SUBCASE("Testing incremental_sort with an empty vector") {
+    std::vector<int> vec;
+
+    CHECK(mt::incremental_sort(vec.begin(), vec.end(), less, 0) == 0);
+  }
 }
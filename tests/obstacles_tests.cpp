@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "../doctest.h"
 #include "../simulation/obstacles.hpp"
 
@@ -49,9 +51,9 @@ TEST_CASE("Testing the add_fixed_obstacle function") {
   // add_fixed_obstacle takes: vector_of_obstacles, pos {x,y}, size, space{x,y};
 
   SUBCASE("Testing the add_fixed_obstacle with two not overlapping obstacles") {
-    std::valarray<double> space{1920., 1080};
-    std::valarray<double> pos1{50., 60.};
-    std::valarray<double> pos2{100., 100.};
+    mt::Vec2 space{1920., 1080};
+    mt::Vec2 pos1{50., 60.};
+    mt::Vec2 pos2{100., 100.};
 
     std::vector<ob::Obstacle> g_obstacles;
     ob::add_fixed_obstacle(g_obstacles, pos1, 20., space);
@@ -66,9 +68,9 @@ TEST_CASE("Testing the add_fixed_obstacle function") {
   }
 
   SUBCASE("Testing the add_fixed_obstacle with two overlapping obstacles") {
-    std::valarray<double> space{1920., 1080};
-    std::valarray<double> pos1{50., 60.};
-    std::valarray<double> pos2{60., 100.};
+    mt::Vec2 space{1920., 1080};
+    mt::Vec2 pos1{50., 60.};
+    mt::Vec2 pos2{60., 90.};
 
     std::vector<ob::Obstacle> g_obstacles;
     ob::add_fixed_obstacle(g_obstacles, pos1, 20., space);
@@ -83,9 +85,9 @@ TEST_CASE("Testing the add_fixed_obstacle function") {
   SUBCASE(
       "Testing the add_fixed_obstacle function with obstacle on the border of "
       "simulation area") {
-    std::valarray<double> space{1920., 1080};
-    std::valarray<double> pos1{150., 160.};
-    std::valarray<double> pos2{10., 100.};
+    mt::Vec2 space{1920., 1080};
+    mt::Vec2 pos1{150., 160.};
+    mt::Vec2 pos2{10., 100.};
 
     std::vector<ob::Obstacle> g_obstacles;
     ob::add_fixed_obstacle(g_obstacles, pos1, 20., space);
@@ -100,9 +102,9 @@ TEST_CASE("Testing the add_fixed_obstacle function") {
   SUBCASE(
       "Testing the add_fixed_obstacle function with obstacle on the border of "
       "simulation area") {
-    std::valarray<double> space{1920., 1080};
-    std::valarray<double> pos1{150., 160.};
-    std::valarray<double> pos2{1890., 1060.};
+    mt::Vec2 space{1920., 1080};
+    mt::Vec2 pos1{150., 160.};
+    mt::Vec2 pos2{1890., 1060.};
 
     std::vector<ob::Obstacle> g_obstacles;
     ob::add_fixed_obstacle(g_obstacles, pos1, 20., space);
@@ -114,11 +116,27 @@ TEST_CASE("Testing the add_fixed_obstacle function") {
     CHECK(g_obstacles[0].get_size() == 20.);
   }
 
+  SUBCASE(
+      "Testing the add_fixed_obstacle with obstacles far apart on the same "
+      "column") {
+    mt::Vec2 space{1920., 1080};
+
+    std::vector<ob::Obstacle> g_obstacles;
+    ob::add_fixed_obstacle(g_obstacles, {300., 60.}, 20., space);
+    ob::add_fixed_obstacle(g_obstacles, {100., 500.}, 20., space);
+    ob::add_fixed_obstacle(g_obstacles, {300., 700.}, 20., space);
+
+    CHECK(g_obstacles.size() == 3);
+    CHECK(g_obstacles[0].get_pos()[0] == 100.);
+    CHECK(g_obstacles[1].get_pos()[1] == 60.);
+    CHECK(g_obstacles[2].get_pos()[1] == 700.);
+  }
+
   SUBCASE(
       "Testing the add_fixed_obstacle function with two tangent obstacles") {
-    std::valarray<double> space{1920., 1080};
-    std::valarray<double> pos1{50., 60.};
-    std::valarray<double> pos2{90., 100.};
+    mt::Vec2 space{1920., 1080};
+    mt::Vec2 pos1{50., 60.};
+    mt::Vec2 pos2{90., 100.};
 
     std::vector<ob::Obstacle> g_obstacles;
     ob::add_fixed_obstacle(g_obstacles, pos1, 20., space);
@@ -229,4 +247,67 @@ TEST_CASE("Testing the sort_obstacles function") {
     CHECK(g_obstacles[6].get_pos()[0] == 1200.);
     CHECK(g_obstacles[6].get_pos()[1] == 900.);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Testing the ObstacleGrid class") {
+  std::vector<ob::Obstacle> obstacles{ob::Obstacle({100., 100.}, 20.),
+                                      ob::Obstacle({500., 100.}, 10.),
+                                      ob::Obstacle({130., 160.}, 15.)};
+  ob::ObstacleGrid grid;
+  grid.update(obstacles, {1920., 1080.});
+
+  SUBCASE("Testing ObstacleGrid::for_each_near") {
+    int near{0};
+    grid.for_each_near({110., 120.}, 10.,
+                       [&near](ob::Obstacle const& ob) {
+                         CHECK(ob.get_pos()[0] != 500.);
+                         ++near;
+                       });
+    CHECK(grid.size() == 3);
+    CHECK(near == 2);
+  }
+
+  SUBCASE("Testing ObstacleGrid::update after a change") {
+    obstacles.push_back(ob::Obstacle({520., 110.}, 10.));
+    grid.update(obstacles, {1920., 1080.});
+
+    int near{0};
+    grid.for_each_near({510., 100.}, 5.,
+                       [&near](ob::Obstacle const&) { ++near; });
+    CHECK(grid.size() == 4);
+    CHECK(near == 2);
+  }
+  SUBCASE("Testing ObstacleGrid::overlaps") {
+    CHECK(grid.overlaps({100., 135.}, 20.) == true);
+    CHECK(grid.overlaps({300., 300.}, 20.) == false);
+    CHECK(grid.overlaps({500., 125.}, 15.) == false);
+  }
+
+  SUBCASE("Testing ObstacleGrid::insert with many obstacles") {
+    for (int i = 0; i < 200; ++i) {
+      grid.insert(ob::Obstacle({5. + 9. * i, 800.}, 4.));
+    }
+
+    int near{0};
+    grid.for_each_near({500., 800.}, 1.,
+                       [&near](ob::Obstacle const& ob) {
+                         (std::abs(ob.get_pos()[0] - 500.) < 10.) ? ++near
+                                                                   : near;
+                       });
+    CHECK(grid.size() == 203);
+    CHECK(grid.get_obstacles()[3].get_pos()[0] == 5.);
+    CHECK(near == 3);
+  }
+
+  SUBCASE("Testing add_obstacle through an ObstacleGrid") {
+    mt::Vec2 space{1920., 1080.};
+
+    CHECK(ob::add_obstacle(obstacles, grid, {105., 110.}, 16., space) ==
+          false);
+    CHECK(ob::add_obstacle(obstacles, grid, {800., 500.}, 16., space) == true);
+    CHECK(ob::add_obstacle(obstacles, grid, {10., 500.}, 16., space) == false);
+    CHECK(obstacles.size() == 4);
+    CHECK(grid.size() == 4);
+    CHECK(grid.overlaps({805., 500.}, 1.) == true);
+  }
+}
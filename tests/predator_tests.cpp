@@ -69,6 +69,32 @@ TEST_CASE("Testing the Predator::Predate method") {
   }
 }
 
+TEST_CASE("Testing the bucket_preys function") {
+  bd::Boid bd1({156., 108.}, {1., -2.}, 120., {1920., 1080.}, 5., 4.);
+  bd::Boid bd2({148., 113.}, {2., -1}, 120., {1920., 1080.}, 5., 4.);
+  bd::Boid bd3({150., 110.}, {2., -1}, 120., {1920., 1080.}, 5., 4.);
+
+  std::vector<std::pair<bd::Boid, int>> preys{{bd1, 2}, {bd2, 0}, {bd3, 2}};
+  pr::PreyBuckets buckets = pr::bucket_preys(preys, 3);
+
+  CHECK(buckets.start == std::vector<std::size_t>{0, 1, 1, 3});
+  CHECK(buckets.boids.size() == 3);
+  CHECK(buckets.boids[0].get_pos() == bd2.get_pos());
+  CHECK(buckets.boids[1].get_pos() == bd1.get_pos());
+  CHECK(buckets.boids[2].get_pos() == bd3.get_pos());
+
+  // predate on a bucket gives the same result as on a vector
+  pr::Predator pr({152., 114.}, {-1., -1.}, 120., 10., 2., {1920., 1080.},
+                  10., 2.);
+  std::vector<bd::Boid> own_preys{bd1, bd3};
+  CHECK(pr.predate(buckets.boids.data() + buckets.start[2],
+                   buckets.boids.data() + buckets.start[3]) ==
+        pr.predate(own_preys));
+  CHECK(pr.predate(buckets.boids.data() + buckets.start[1],
+                   buckets.boids.data() + buckets.start[2]) ==
+        mt::Vec2{0., 0.});
+}
+
 TEST_CASE("Testing the get_vector_neighbours") {
   pr::Predator pd1({154., 112.}, {-1., -1.}, 120., 10., 2., {1920., 1080.}, 10.,
                    2.);
@@ -171,20 +197,20 @@ TEST_CASE("Testing the random_predators generation") {
     bool overlap_pd1 =
         (preds[0].get_pos()[0] < 20. || preds[0].get_pos()[0] > 1900 ||
          preds[0].get_pos()[1] < 20. || preds[0].get_pos()[1] > 1060 ||
-         mt::vec_norm<double>(preds[0].get_pos() - ob1.get_pos()) < 63 ||
-         mt::vec_norm<double>(preds[0].get_pos() - ob2.get_pos()) < 73);
+         mt::vec_norm(preds[0].get_pos() - ob1.get_pos()) < 63 ||
+         mt::vec_norm(preds[0].get_pos() - ob2.get_pos()) < 73);
 
     bool overlap_pd2 =
         (preds[1].get_pos()[0] < 20. || preds[1].get_pos()[0] > 1900 ||
          preds[1].get_pos()[1] < 20. || preds[1].get_pos()[1] > 1060 ||
-         mt::vec_norm<double>(preds[1].get_pos() - ob1.get_pos()) < 63 ||
-         mt::vec_norm<double>(preds[1].get_pos() - ob2.get_pos()) < 73);
+         mt::vec_norm(preds[1].get_pos() - ob1.get_pos()) < 63 ||
+         mt::vec_norm(preds[1].get_pos() - ob2.get_pos()) < 73);
 
     bool overlap_pd3 =
         (preds[2].get_pos()[0] < 20. || preds[2].get_pos()[0] > 1900 ||
          preds[2].get_pos()[1] < 20. || preds[2].get_pos()[1] > 1060 ||
-         mt::vec_norm<double>(preds[2].get_pos() - ob1.get_pos()) < 63 ||
-         mt::vec_norm<double>(preds[2].get_pos() - ob2.get_pos()) < 73);
+         mt::vec_norm(preds[2].get_pos() - ob1.get_pos()) < 63 ||
+         mt::vec_norm(preds[2].get_pos() - ob2.get_pos()) < 73);
 
     CHECK(overlap_pd1 == false);
     CHECK(overlap_pd2 == false);
@@ -0,0 +1,73 @@
+#include <vector>
+
+#include "../doctest.h"
+#include "../simulation/flock.hpp"
+#include "../simulation/obstacles.hpp"
+#include "../simulation/predator.hpp"
+#include "../simulation/random.hpp"
+
+TEST_CASE("Testing the Philox generator") {
+  SUBCASE("Testing Philox against the reference output") {
+    // Philox4x32-10 with null key and counter
+    rn::Philox engine(0, 0);
+    CHECK(engine() == 0x6627e8d5);
+    CHECK(engine() == 0xe169c58d);
+    CHECK(engine() == 0xbc57ac4c);
+    CHECK(engine() == 0x9b00dbd8);
+  }
+
+  SUBCASE("Testing that streams and seeds give different outputs") {
+    rn::Philox engine_1(42, 0);
+    rn::Philox engine_2(42, 1);
+    rn::Philox engine_3(43, 0);
+    rn::Philox engine_4(42, 0);
+    auto first = engine_1();
+    CHECK(first != engine_2());
+    CHECK(first != engine_3());
+    CHECK(first == engine_4());
+    // The outputs go on after the first block
+    std::vector<std::uint32_t> outputs;
+    for (int i = 0; i < 8; ++i) outputs.push_back(engine_1());
+    CHECK(outputs[0] != outputs[4]);
+  }
+}
+
+TEST_CASE("Testing the simulation seed") {
+  fk::Parameters params(40, 10, 0.4, 0.4, 0.03);
+  mt::Vec2 space{600., 400.};
+
+  SUBCASE("Testing that a seed always gives the same world") {
+    rn::set_seed(2024);
+    CHECK(rn::get_seed() == 2024);
+    auto obstacles_1 = ob::generate_obstacles(5, 30., space);
+    fk::Flock flock_1(params, 300, 120., space, obstacles_1);
+    auto preds_1 = pr::random_predators(obstacles_1, 3, space, 120., 20., 0.3,
+                                        100., 0.5);
+
+    rn::set_seed(2024);
+    auto obstacles_2 = ob::generate_obstacles(5, 30., space);
+    fk::Flock flock_2(params, 300, 120., space, obstacles_2);
+    auto preds_2 = pr::random_predators(obstacles_2, 3, space, 120., 20., 0.3,
+                                        100., 0.5);
+
+    for (std::size_t i = 0; i < obstacles_1.size(); ++i) {
+      CHECK(obstacles_1[i].get_pos() == obstacles_2[i].get_pos());
+      CHECK(obstacles_1[i].get_size() == obstacles_2[i].get_size());
+    }
+    CHECK(flock_1.get_state().x == flock_2.get_state().x);
+    CHECK(flock_1.get_state().y == flock_2.get_state().y);
+    CHECK(flock_1.get_state().vx == flock_2.get_state().vx);
+    for (std::size_t i = 0; i < preds_1.size(); ++i) {
+      CHECK(preds_1[i].get_pos() == preds_2[i].get_pos());
+      CHECK(preds_1[i].get_vel() == preds_2[i].get_vel());
+    }
+  }
+
+  SUBCASE("Testing that different seeds give different flocks") {
+    rn::set_seed(1);
+    fk::Flock flock_1(params, 100, 120., space);
+    rn::set_seed(2);
+    fk::Flock flock_2(params, 100, 120., space);
+    CHECK(flock_1.get_state().vx != flock_2.get_state().vx);
+  }
+}
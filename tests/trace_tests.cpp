@@ -0,0 +1,67 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../doctest.h"
+#include "../simulation/trace.hpp"
+
+TEST_CASE("Testing the trace spans") {
+  tr::clear();
+
+  SUBCASE("Testing that nested spans are recorded") {
+    {
+      tr::Span outer("outer");
+      tr::Span inner("inner");
+    }
+    auto events = tr::collect();
+    REQUIRE(events.size() == 2);
+    // Both spans may start in the same nanosecond, so their order is not
+    // checked: the inner interval lies in the outer one
+    bool const outer_first = std::string(events[0].name) == "outer";
+    auto const& outer = outer_first ? events[0] : events[1];
+    auto const& inner = outer_first ? events[1] : events[0];
+    CHECK(std::string(outer.name) == "outer");
+    CHECK(std::string(inner.name) == "inner");
+    CHECK(outer.start <= inner.start);
+    CHECK(outer.start + outer.duration >= inner.start + inner.duration);
+    CHECK(outer.thread == inner.thread);
+  }
+
+  SUBCASE("Testing that the buffer keeps the last events") {
+    for (std::size_t i = 0; i < tr::buffer_capacity + 10; ++i) {
+      tr::record("old", 0, 1);
+    }
+    tr::record("new", 5, 8);
+    auto events = tr::collect();
+    REQUIRE(events.size() == tr::buffer_capacity);
+    CHECK(std::string(events.back().name) == "new");
+    CHECK(events.back().duration == 3);
+  }
+
+  SUBCASE("Testing events of different threads") {
+    std::thread worker([] { tr::record("worker", 10, 20); });
+    worker.join();
+    tr::record("main", 30, 40);
+    auto events = tr::collect();
+    REQUIRE(events.size() == 2);
+    CHECK(std::string(events[0].name) == "worker");
+    CHECK(events[0].thread != events[1].thread);
+  }
+
+  SUBCASE("Testing the Chrome trace output") {
+    tr::record("sort", 1000, 3500);
+    auto thread = std::to_string(tr::collect()[0].thread);
+    std::ostringstream out;
+    tr::write_chrome(out);
+    CHECK(out.str() ==
+          "{\"traceEvents\": [\n"
+          "{\"name\": \"sort\", \"cat\": \"boids\", \"ph\": \"X\", "
+          "\"pid\": 1, \"tid\": " +
+              thread +
+              ", \"ts\": 1.000, \"dur\": 2.500}\n"
+              "], \"displayTimeUnit\": \"ms\"}\n");
+  }
+
+  tr::clear();
+}